@@ -24,13 +24,14 @@
 #include <config.h>
 
 // Language headers
+#include <cstdint>
 #include <memory>
 #include <utility>
 #include <vector>
-#include <algorithm>
-#include <iostream>
-#include <cstdlib>
-#include <ctime>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <thread>
 
 // Library headers
 #include <glibmm.h>
@@ -38,7 +39,14 @@
 
 // Project headers
 #include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "search.hxx"
+#include "montecarlo.hxx"
+#include "transposition.hxx"
+#include "book.hxx"
 #include "ai.hxx"
 #include "game.hxx"
 
@@ -48,21 +56,49 @@
 //
 
 AI::AI(Game *game, const BoardState *bs, const GameType *gt)
-	: m_pBoardState(bs), m_pGameType(gt)
+	: m_pBoardState(bs), m_pGameType(gt), m_pSearch(new Search),
+		m_pTT(new TranspositionTable(INFECTOR_HASH_MB)), m_pBook(new OpeningBook),
+		m_Found(false), m_Thought(0)
 {
 	game->move_made.connect(sigc::mem_fun(*this, &AI::onMoveMade));
-	
-	// Seed the random number generator (moves are picked at random if there
-	// are multiple possibilities with the same score, such as in the opening)
-	srand(time(NULL));
+	m_SearchDone.connect(sigc::mem_fun(*this, &AI::onSearchDone));
+
+	// Think for a little less than the delay before we show our move,
+	// so that the game moves along at the same pace as before
+	m_pSearch->setTimeBudget(400);
+	m_pSearch->setTranspositionTable(m_pTT.get());
+	if (INFECTOR_SEARCH_THREADS > 0)
+		m_pSearch->setThreads(INFECTOR_SEARCH_THREADS);
+	m_pSearch->setEndgameEmpties(INFECTOR_ENDGAME_EMPTIES);
+	if (m_pBook->open(INFECTOR_PKGDATADIR "/infector.book"))
+		m_pSearch->setOpeningBook(m_pBook.get());
+
+	// Tuned evaluation weights, if any are installed
+	EvalWeights weights;
+	if (weights.load(INFECTOR_PKGDATADIR "/infector.weights"))
+		m_pSearch->setWeights(weights);
+
+	if (m_pGameType->anyAIsUsing(ae_montecarlo))
+	{
+		m_pMonteCarlo.reset(new MonteCarloSearch);
+		m_pMonteCarlo->setTimeBudget(400);
+		m_pMonteCarlo->setTreeSize(INFECTOR_TREE_MB);
+		if (INFECTOR_SEARCH_THREADS > 0)
+			m_pMonteCarlo->setThreads(INFECTOR_SEARCH_THREADS);
+	}
 	
 	// Make a move if it's our turn first
 	onMoveMade(0, 0, 0, 0, false);
 }
 
-bool movecmp(const std::pair<move, int> &a, const std::pair<move, int> &b)
+AI::~AI()
 {
-	return a.second > b.second;
+	// Game is being abandoned - don't wait for a search to run its course
+	m_pSearch->cancel();
+	if (m_pMonteCarlo)
+		m_pMonteCarlo->cancel();
+	if (m_Worker.joinable())
+		m_Worker.join();
 }
 
 void AI::onMoveMade(const int start_x, const int start_y, const int end_x, const int end_y, const bool gameover)
@@ -71,149 +107,63 @@ void AI::onMoveMade(const int start_x, const int start_y, const int end_x, const
 		return;
 
 	piece me = m_pBoardState->getPlayer();
-	if (m_pGameType->isPlayerType(me, pt_ai))
+	if (m_pGameType->isPlayerType(me, pt_ai) && !m_Worker.joinable())
 	{
-		// Get all possible moves, and allocate a second vector for storing them plus their scores
-		std::vector<move> moves(m_pBoardState->getPossibleMoves(me));
-		std::vector<std::pair<move, int> > scoredmoves;
-		scoredmoves.reserve(moves.size());
-		
-		// Score all possible moves and pick one of the best
-		
-		int s1, s2, s3, s4;
-		m_pBoardState->getScores(s1, s2, s3, s4);
-		
-		for (std::vector<move>::iterator i = moves.begin(); i != moves.end(); ++i)
-		{
-			int score = 0;
-		
-			// Simulate the current move
-			BoardState new_b(*m_pBoardState);
-			int adj = new_b.getAdjacency(i->source_x, i->source_y, i->dest_x, i->dest_y);
-			if (adj == 2)
-				new_b.setPieceAt(i->source_x, i->source_y, pc_player_none);
-			new_b.setPieceAt(i->dest_x, i->dest_y, me);
-			
-			// Calculate how many squares we capture and score 4 points for each
-			int new_s1, new_s2, new_s3, new_s4;
-			new_b.getScores(new_s1, new_s2, new_s3, new_s4);
-			switch (me)
-			{
-				case pc_player_1:
-					score += (new_s1 - s1) * 5;
-					break;
-				case pc_player_2:
-					score += (new_s2 - s2) * 5;
-					break;
-				case pc_player_3:
-					score += (new_s3 - s3) * 5;
-					break;
-				default:
-					score += (new_s4 - s4) * 5;
-			}
-			
-			// Now look at all squares and determine whether
-			// the board overall is in good or bad shape from our point of view
-			for (int y = 0; y < m_pGameType->h; ++y)
-			{
-				for (int x = 0; x < m_pGameType->w; ++x)
-				{
-					piece thisone = new_b.getPieceAt(x, y);
-					if (thisone == pc_no_such_square)
-						continue;
-
-					int distance_one_our_pieces = 0;
-					int distance_two_our_pieces = 0;
-					int distance_one_holes = 0;
-					int distance_one_enemy_pieces = 0;
-					int distance_two_enemy_pieces = 0;
-
-					for (int yy = y - 1; yy <= y + 1; ++yy)
-					{
-						for (int xx = x - 1; xx <= x + 1; ++xx)
-						{
-							piece thatone = new_b.getPieceAt(xx, yy);
-							int adj = new_b.getAdjacency(x, y, xx, yy);
-							if (thatone == pc_no_such_square && adj == 1)
-								++distance_one_holes;
-							else if (thatone != pc_no_such_square && thatone != pc_player_none)
-							{
-								if (adj == 1)
-								{
-									if (thatone == me)
-										++distance_one_our_pieces;
-									else
-										++distance_one_enemy_pieces;
-								}
-								else if (adj == 2)
-								{
-									if (thatone == me)
-										++distance_two_our_pieces;
-									else
-										++distance_two_enemy_pieces;
-								}
-							}
-						}
-					}
-					
-					if (thisone == me)
-						// Score points for defending our own pieces
-						score += (distance_one_our_pieces + distance_one_holes) * 2;
-					else if (thisone != pc_player_none)
-						// Score points for being able to capture enemies
-						score += (distance_two_our_pieces == 0) ? 0 : 1;
-					else if (distance_two_enemy_pieces > 0 || distance_one_enemy_pieces > 0)
-					{
-						// Lose points if we can be captured - based on both number of pieces and how limiting it is to our game						
-						if (distance_one_our_pieces > 0)
-						{
-							score -= distance_one_our_pieces * 4;
-
-							BoardState new_bb(new_b);
-							// Make a move to the current square by any player bar me
-							piece pp = (piece)(me + 1);
-							if (pp == pc_no_such_square)
-								pp = pc_player_1;
-							new_bb.setPieceAt(x, y, pp);
-							
-							int currmoves = new_b.getPossibleMoves(me).size();
-							int nextmoves = new_bb.getPossibleMoves(me).size();
-							
-							score -= (currmoves - nextmoves) / 10;
-						}
-					}
-					
-					// Score for giving ourselves a lot of future options
-					//score += new_b.getPossibleMoves(me).size() / 80;
-				}
-			}
-			
-			scoredmoves.push_back(std::pair<move, int>(*i, score));
-		}
-		
-		// Pick our best move.  Shuffle the list first so we don't know
-		// what will come out on top if we have multiple moves with the same high score.
-		std::random_shuffle(scoredmoves.begin(), scoredmoves.end());
-		std::stable_sort(scoredmoves.begin(), scoredmoves.end(), movecmp);
-		
-		m = scoredmoves.at(0).first;
-		
-		// Highlight the square we're going to move then
-		// make the actual move in 0.5 second time increments
-		// (to let people see)
-		selectpiece = true;
-		Glib::signal_timeout().connect(sigc::mem_fun(*this, &AI::makeMove), 500);
+		// Search for our best move in the background.  The board can't
+		// change under the worker's feet, since it's our turn and nobody
+		// else can move, but take a copy so that it doesn't have to
+		// share anything with the main loop.
+		m_pSearchBoard.reset(new BoardState(*m_pBoardState));
+		m_Worker = std::thread(&AI::search, this);
 	}
 }
 
+// Runs in the worker thread
+void AI::search()
+{
+	// Moves are picked at random if there are multiple possibilities
+	// with the same score, such as in the opening
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	PackedMove best;
+	if (m_pGameType->engineOf(m_pSearchBoard->getPlayer()) == ae_montecarlo)
+		m_Found = m_pMonteCarlo->findMove(*m_pSearchBoard, best);
+	else
+		m_Found = m_pSearch->findMove(*m_pSearchBoard, best);
+	if (m_Found)
+		m = m_pSearchBoard->unpackMove(best);
+	m_Thought = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	m_SearchDone.emit();
+}
+
+// Runs in the main loop once the worker has finished
+void AI::onSearchDone()
+{
+	m_Worker.join();
+	m_pSearchBoard.reset();
+
+	// No move to make, so whatever's left in "m" is from an earlier turn
+	if (!m_Found)
+		return;
+
+	// Highlight the square we're going to move then
+	// make the actual move in 0.5 second time increments
+	// (to let people see), counting time spent thinking
+	selectpiece = true;
+	Glib::signal_timeout().connect(sigc::mem_fun(*this, &AI::makeMove),
+		(m_Thought < 500) ? (500 - m_Thought) : 0);
+}
+
 bool AI::makeMove()
 {
 	if (selectpiece)
 	{
-		// Select the piece we want to move
+		// Select the piece we want to move, then move it after
+		// another 0.5 seconds
 		square_clicked(m.source_x, m.source_y);
 		selectpiece = false;
-		return true;
+		Glib::signal_timeout().connect(sigc::mem_fun(*this, &AI::makeMove), 500);
+		return false;
 	} else {
 		// Move it
 		square_clicked(m.dest_x, m.dest_y);
@@ -20,11 +20,16 @@
 
 class Game;
 class BoardState;
+class Search;
+class MonteCarloSearch;
+class TranspositionTable;
+class OpeningBook;
 
 class AI : public sigc::trackable
 {
 	public:
 		AI(Game *game, const BoardState *bs, const GameType *gt);
+		~AI();
 	
 		// Signals we can emit
 		sigc::signal<void, const int, const int> square_clicked;
@@ -41,6 +46,31 @@ class AI : public sigc::trackable
 		bool makeMove();
 		bool selectpiece;
 		move m;
+
+		// Game tree search for choosing moves, and the transposition table
+		// it uses, which lives for the whole game so that each search can
+		// make use of the work done by the last
+		std::unique_ptr<Search> m_pSearch;
+		std::unique_ptr<TranspositionTable> m_pTT;
+
+		// Monte Carlo tree search, for players who've chosen it instead
+		std::unique_ptr<MonteCarloSearch> m_pMonteCarlo;
+
+		// Opening book, if one is installed
+		std::unique_ptr<OpeningBook> m_pBook;
+
+		// Searches run in a worker thread, on a private copy of the board,
+		// so that the GUI and network sockets stay responsive.  The worker
+		// notifies the main loop through a dispatcher when it's done.
+		std::thread m_Worker;
+		std::unique_ptr<BoardState> m_pSearchBoard;
+		Glib::Dispatcher m_SearchDone;
+		bool m_Found;
+		int m_Thought;
+
+		// Worker thread body, and the main loop's handler for its result
+		void search();
+		void onSearchDone();
 };
 
 #endif
@@ -0,0 +1,463 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Micro-benchmarks for the hot paths of the game engine, run over a fixed
+// set of positions on a few board shapes.  Reports the time and number of
+// heap allocations per operation, then how many random games can be played
+// out per second on each core, and how Monte Carlo tree search scales with
+// the number of threads.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "playout.hxx"
+#include "montecarlo.hxx"
+
+//
+// Allocation counting
+//
+
+static std::atomic<unsigned long> allocations(0);
+
+void *operator new(size_t size)
+{
+	++allocations;
+	void *p = malloc(size ? size : 1);
+	if (!p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+//
+// Types
+//
+
+// A board and the positions to benchmark on it
+struct Corpus
+{
+	const char *name;
+	bool square;
+	int size;
+	int players;
+	GameType gt;
+	std::vector<BoardState> positions[3];
+	Corpus(const char *n, const bool sq, const int sz, const int pl)
+		: name(n), square(sq), size(sz), players(pl)
+	{};
+};
+
+static const char *phases[3] = { "opening", "midgame", "endgame" };
+
+// Something to stop the compiler optimising away results we don't use
+static volatile int sink;
+
+//
+// Implementation
+//
+
+// Fill in the positions for a board by playing random games with a fixed
+// seed: the starting position and the first few moves, then positions
+// around half full, then nearly full
+static void buildCorpus(Corpus &c)
+{
+	c.gt.square = c.square;
+	c.gt.w = c.size;
+	c.gt.h = c.size;
+	c.gt.player_1 = pt_ai;
+	c.gt.player_2 = pt_ai;
+	if (c.players == 4)
+	{
+		c.gt.player_3 = pt_ai;
+		c.gt.player_4 = pt_ai;
+	}
+
+	// Every position refers back to the corpus's game type
+	BoardState start(&c.gt);
+	std::mt19937 random(1);
+	for (int game = 0; (game < 100) && (c.positions[2].size() < 8); ++game)
+	{
+		BoardState b(start);
+		const int squares = b.getGeometry()->squares;
+		std::vector<PackedMove> moves(b.getMaxMoves());
+		for (;;)
+		{
+			int filled = 0;
+			int scores[4];
+			b.getScores(scores[0], scores[1], scores[2], scores[3]);
+			for (int i = 0; i < c.players; ++i)
+				filled += scores[i];
+
+			int phase = -1;
+			if (filled <= (c.players == 4 ? 6 : 10))
+				phase = 0;
+			else if ((filled * 100 >= squares * 45) && (filled * 100 <= squares * 55))
+				phase = 1;
+			else if (filled * 100 >= squares * 85)
+				phase = 2;
+			if ((phase != -1) && (c.positions[phase].size() < 8))
+				c.positions[phase].push_back(b);
+
+			piece p = b.getPlayer();
+			unsigned int n = b.generateMoves(p, moves.data(), moves.size());
+			b.makeMove(moves[random() % n]);
+			if (!b.skipBlockedPlayers(p))
+				break;
+		}
+	}
+}
+
+// Run "op" over every position in a phase, repeating until enough time
+// has passed to get a stable reading, and report the cost of each call
+template <typename Op> static void measure(const Corpus &c, const int phase,
+	const char *name, const int ms, Op op)
+{
+	const std::vector<BoardState> &positions = c.positions[phase];
+	if (positions.empty())
+		return;
+
+	unsigned long ops = 0;
+	unsigned long allocs = allocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration elapsed;
+	do
+	{
+		for (int rep = 0; rep < 16; ++rep)
+		{
+			for (size_t i = 0; i < positions.size(); ++i)
+				ops += op(positions[i]);
+		}
+		elapsed = std::chrono::steady_clock::now() - start;
+	} while (elapsed < std::chrono::milliseconds(ms));
+	allocs = allocations - allocs;
+
+	double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+	printf("%-8s %-8s %-20s %12.1f %10.2f\n", c.name, phases[phase], name,
+		ns / ops, (double)allocs / ops);
+}
+
+static void benchmark(const Corpus &c, const int phase, const int ms)
+{
+	Evaluator eval;
+
+	measure(c, phase, "copy", ms, [](const BoardState &b)
+	{
+		BoardState copy(b);
+		sink = copy.getPlayer();
+		return 1;
+	});
+
+	measure(c, phase, "getPossibleMoves", ms, [](const BoardState &b)
+	{
+		sink = b.getPossibleMoves(b.getPlayer()).size();
+		return 1;
+	});
+
+	std::vector<PackedMove> moves;
+	measure(c, phase, "generateMoves", ms, [&moves](const BoardState &b)
+	{
+		moves.resize(b.getMaxMoves());
+		sink = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+		return 1;
+	});
+
+	measure(c, phase, "canMove", ms, [](const BoardState &b)
+	{
+		int n = 0;
+		for (int p = pc_player_1; p <= pc_player_4; ++p)
+			n += b.canMove((piece)p);
+		sink = n;
+		return 4;
+	});
+
+	measure(c, phase, "getMobilePlayers", ms, [](const BoardState &b)
+	{
+		sink = b.getMobilePlayers();
+		return 1;
+	});
+
+	// Capture handling through the GUI's path, which works on a copy
+	measure(c, phase, "copy+setPieceAt", ms, [&moves](const BoardState &b)
+	{
+		moves.resize(b.getMaxMoves());
+		unsigned int n = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+		const BoardGeometry &g = *b.getGeometry();
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			BoardState copy(b);
+			copy.setPieceAt(g.xOf(moves[i].dest()), g.yOf(moves[i].dest()), b.getPlayer());
+			sink = copy.getPlayer();
+		}
+		return n;
+	});
+
+	measure(c, phase, "makeMove+unmakeMove", ms, [&moves](const BoardState &b)
+	{
+		BoardState copy(b);
+		moves.resize(b.getMaxMoves());
+		unsigned int n = copy.generateMoves(copy.getPlayer(), moves.data(), moves.size());
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			MoveUndo u = copy.makeMove(moves[i]);
+			copy.unmakeMove(u);
+		}
+		sink = copy.getPlayer();
+		return n;
+	});
+
+	measure(c, phase, "evaluate", ms, [&eval](const BoardState &b)
+	{
+		sink = eval.evaluate(b, b.getPlayer());
+		return 1;
+	});
+
+	// Scoring every move from a position, as the search does
+	measure(c, phase, "move+evaluate", ms, [&eval, &moves](const BoardState &b)
+	{
+		BoardState copy(b);
+		piece me = copy.getPlayer();
+		moves.resize(b.getMaxMoves());
+		unsigned int n = copy.generateMoves(copy.getPlayer(), moves.data(), moves.size());
+		int total = 0;
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			MoveUndo u = copy.makeMove(moves[i]);
+			total += eval.evaluate(copy, me);
+			copy.unmakeMove(u);
+		}
+		sink = total;
+		return n;
+	});
+
+	// The same, in one batch without making the moves
+	std::vector<int> scores;
+	measure(c, phase, "evaluateMoves", ms, [&eval, &moves, &scores](const BoardState &b)
+	{
+		moves.resize(b.getMaxMoves());
+		scores.resize(b.getMaxMoves());
+		unsigned int n = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+		eval.evaluateMoves(b, b.getPlayer(), moves.data(), n, scores.data());
+		int total = 0;
+		for (unsigned int i = 0; i < n; ++i)
+			total += scores[i];
+		sink = total;
+		return n;
+	});
+}
+
+// Play games out from the opening positions with "op", which returns how
+// many moves it made, on one thread per core at once until enough time has
+// passed, and report how many games were finished per second on each core
+template <typename Op> static void measurePlayouts(const Corpus &c, const char *name,
+	const int ms, Op op)
+{
+	const std::vector<BoardState> &positions = c.positions[0];
+	if (positions.empty())
+		return;
+
+	const unsigned int threads = std::max(std::thread::hardware_concurrency(), 1U);
+	std::vector<unsigned long> playouts(threads, 0), moves(threads, 0);
+	std::vector<std::thread> workers;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		workers.push_back(std::thread([&, t]()
+		{
+			std::mt19937 random(t + 1);
+			do
+			{
+				for (int rep = 0; rep < 16; ++rep)
+				{
+					for (size_t i = 0; i < positions.size(); ++i)
+						moves[t] += op(positions[i], random);
+				}
+				playouts[t] += 16 * positions.size();
+			} while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(ms));
+		}));
+	}
+	for (unsigned int t = 0; t < threads; ++t)
+		workers[t].join();
+	double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	unsigned long total = 0, made = 0;
+	for (unsigned int t = 0; t < threads; ++t)
+	{
+		total += playouts[t];
+		made += moves[t];
+	}
+	printf("%-8s %-20s %16.0f %14.1f\n", c.name, name, total / s / threads,
+		(double)made / total);
+}
+
+static void benchmarkPlayouts(const Corpus &c, const int ms)
+{
+	// The same games through BoardState, as the rest of the engine plays
+	// them, for comparison
+	measurePlayouts(c, "BoardState", ms, [](const BoardState &start, std::mt19937 &random)
+	{
+		BoardState b(start);
+		MoveList<> moves;
+		int made = 0;
+		for (;;)
+		{
+			piece p = b.getPlayer();
+			moves.generate(b);
+			b.makeMove(moves[random() % moves.size]);
+			++made;
+			if (!b.skipBlockedPlayers(p))
+			{
+				b.fillEmpty(p);
+				break;
+			}
+		}
+		sink = b.getPlayer();
+		return made;
+	});
+
+	measurePlayouts(c, "playout (uniform)", ms, [](const BoardState &b, std::mt19937 &random)
+	{
+		int scores[4];
+		bool finished;
+		int made = playout(b, random, pp_uniform, 0, scores, finished);
+		sink = scores[0];
+		return made;
+	});
+
+	measurePlayouts(c, "playout (captures)", ms, [](const BoardState &b, std::mt19937 &random)
+	{
+		int scores[4];
+		bool finished;
+		int made = playout(b, random, pp_captures, 0, scores, finished);
+		sink = scores[0];
+		return made;
+	});
+}
+
+// Search the opening positions with Monte Carlo tree search on 1, 2, 4...
+// threads up to one per core, and report how many playouts and tree nodes
+// were added per second, and the speedup in playouts over one thread
+static void benchmarkTreeSearch(const Corpus &c, const int ms)
+{
+	const std::vector<BoardState> &positions = c.positions[0];
+	if (positions.empty())
+		return;
+
+	const unsigned int cores = std::max(std::thread::hardware_concurrency(), 1U);
+	MonteCarloSearch mcts;
+	mcts.setTimeBudget(ms);
+	mcts.setSeed(1);
+	double single = 0;
+	for (unsigned int threads = 1; ; threads = std::min(threads * 2, cores))
+	{
+		mcts.setThreads(threads);
+		unsigned long playouts = 0, nodes = 0;
+		std::chrono::steady_clock::duration elapsed(0);
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			PackedMove best;
+			mcts.clear();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			mcts.findMove(positions[i], best);
+			elapsed += std::chrono::steady_clock::now() - start;
+			playouts += mcts.getNodes();
+			nodes += mcts.getTreeSize();
+		}
+		double s = std::chrono::duration<double>(elapsed).count();
+		if (threads == 1)
+			single = playouts / s;
+		printf("%-8s %8u %14.0f %14.0f %10.2f\n", c.name, threads, playouts / s,
+			nodes / s, playouts / s / single);
+		if (threads == cores)
+			break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	// Minimum time to spend on each measurement, in milliseconds
+	int ms = 20;
+	if ((argc == 3) && (strcmp(argv[1], "-t") == 0))
+		ms = atoi(argv[2]);
+	else if (argc != 1)
+	{
+		fprintf(stderr, "Usage: %s [-t MS]\n", argv[0]);
+		return 1;
+	}
+
+	Corpus corpora[] = {
+		Corpus("sq7", true, 7, 2),
+		Corpus("sq8", true, 8, 2),
+		Corpus("hex5", false, 5, 2),
+		Corpus("sq8/4", true, 8, 4)
+	};
+
+	printf("%-8s %-8s %-20s %12s %10s\n", "board", "phase", "operation",
+		"ns/op", "allocs/op");
+	for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+	{
+		buildCorpus(corpora[i]);
+		for (int phase = 0; phase < 3; ++phase)
+			benchmark(corpora[i], phase, ms);
+	}
+
+	printf("\n%-8s %-20s %16s %14s\n", "board", "method", "playouts/s/core",
+		"moves/playout");
+	for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+		benchmarkPlayouts(corpora[i], ms);
+
+	// Searches are given ten times as long as other measurements, since
+	// they include setting up the tree
+	printf("\n%-8s %8s %14s %14s %10s\n", "board", "threads", "playouts/s",
+		"tree nodes/s", "speedup");
+	for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); ++i)
+		benchmarkTreeSearch(corpora[i], ms * 10);
+	return 0;
+}
@@ -0,0 +1,130 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_BITBOARD_HXX
+#define INFECTOR_BITBOARD_HXX
+
+// Number of 64-bit words in a bitboard.  Squares are numbered row by row,
+// with two unused padding bits at the end of each row so that shifting by
+// up to two columns never wraps onto a neighbouring row.  The largest board
+// we offer is the size 20 hexagonal board, which is 39 squares across once
+// the corners are chopped off: 39 rows of (39 + 2) bits fit in 25 words.
+#define BITBOARD_WORDS 25
+#define BITBOARD_BITS (BITBOARD_WORDS * 64)
+
+// Fixed-size set of board squares.  Plain data, so copying one is a simple
+// memberwise copy with no heap traffic.  Operations which work on the whole
+// board take the number of words actually in use by the current board shape,
+// so that small boards don't pay for the largest one.
+struct Bitboard
+{
+	uint64_t words[BITBOARD_WORDS];
+
+	void clear()
+	{
+		for (int i = 0; i < BITBOARD_WORDS; ++i)
+			words[i] = 0;
+	};
+
+	bool test(const int i) const
+	{
+		return (words[i >> 6] >> (i & 63)) & 1;
+	};
+
+	void set(const int i)
+	{
+		words[i >> 6] |= (uint64_t)1 << (i & 63);
+	};
+
+	void reset(const int i)
+	{
+		words[i >> 6] &= ~((uint64_t)1 << (i & 63));
+	};
+
+	// Is any square in the set?
+	bool any(const int n) const
+	{
+		uint64_t acc = 0;
+		for (int i = 0; i < n; ++i)
+			acc |= words[i];
+		return (acc != 0);
+	};
+
+	// Number of squares in the set
+	int count(const int n) const
+	{
+		int c = 0;
+		for (int i = 0; i < n; ++i)
+			c += __builtin_popcountll(words[i]);
+		return c;
+	};
+
+	// Index of the lowest square in the set, or -1 if empty
+	int first(const int n) const
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			if (words[i])
+				return (i << 6) + __builtin_ctzll(words[i]);
+		}
+		return -1;
+	};
+
+	// Remove and return the lowest square in the set, or -1 if empty
+	int pop(const int n)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			if (words[i])
+			{
+				int b = __builtin_ctzll(words[i]);
+				words[i] &= words[i] - 1;
+				return (i << 6) + b;
+			}
+		}
+		return -1;
+	};
+
+	// OR "src" into this set, moved by "k" squares (positive k moves towards
+	// higher square indices).  Squares moved off either end are dropped.
+	// Words are visited in the order that lets "src" be this set itself.
+	void orShifted(const Bitboard &src, const int n, const int k)
+	{
+		if (k >= 0)
+		{
+			const int q = k >> 6, r = k & 63;
+			for (int i = n - 1; i >= q; --i)
+			{
+				uint64_t v = src.words[i - q] << r;
+				if (r && (i - q - 1 >= 0))
+					v |= src.words[i - q - 1] >> (64 - r);
+				words[i] |= v;
+			}
+		} else {
+			const int q = (-k) >> 6, r = (-k) & 63;
+			for (int i = 0; i + q < n; ++i)
+			{
+				uint64_t v = src.words[i + q] >> r;
+				if (r && (i + q + 1 < n))
+					v |= src.words[i + q + 1] << (64 - r);
+				words[i] |= v;
+			}
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,371 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Project headers
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardkernel.hxx"
+
+//
+// Globals
+//
+
+// "Adjacency map" for hexagonal boards
+static const char *map =
+	"00222"
+	"02112"
+	"21012"
+	"21120"
+	"22200";
+
+// Geometries built so far, and a lock for adding to the list
+static std::vector<std::unique_ptr<BoardGeometry> > geometries;
+static std::mutex geometries_lock;
+
+//
+// Implementation
+//
+
+bool BoardGeometry::supported(const bool square, const int w, const int h)
+{
+	if ((w < 2) || (h < 2))
+		return false;
+	if (!square)
+	{
+		int n = (w + h) - 1;
+		return ((n * (n + 2)) <= BITBOARD_BITS);
+	}
+	return ((h * (w + 2)) <= BITBOARD_BITS);
+}
+
+const BoardGeometry *BoardGeometry::get(const bool square, const int w, const int h)
+{
+	std::lock_guard<std::mutex> lock(geometries_lock);
+	for (std::vector<std::unique_ptr<BoardGeometry> >::const_iterator i = geometries.begin();
+		i != geometries.end(); ++i)
+	{
+		if (((*i)->square == square) && ((*i)->type_w == w) && ((*i)->type_h == h))
+			return i->get();
+	}
+	geometries.push_back(std::unique_ptr<BoardGeometry>(new BoardGeometry(square, w, h)));
+	return geometries.back().get();
+}
+
+BoardGeometry::BoardGeometry(const bool sq, const int gw, const int gh)
+	: square(sq), type_w(gw), type_h(gh)
+{
+	if (square)
+	{
+		w = gw;
+		h = gh;
+		initial_offset = 0;
+	} else {
+		// Hexagonal board, stored as a square with the corners cut off.
+		// Column x starts (h - 1) - x squares down until we reach the
+		// midpoint, and the columns then get shorter from the bottom:
+		//
+		// (0, 0) * / ***** |
+		//         / ****** |
+		// height / ******* |  width
+		//       / ******** |
+		//      / ********* |
+		//        ********
+		//        *******
+		//        ******
+		//        *****   *  ((width + height) - 1, (width + height) - 1)
+		//
+		// which makes a square exist iff (gh - 1) <= (x + y) <= (w + gh) - 2,
+		// with w being the width of the bounding box.
+		w = (gw + gh) - 1;
+		h = w;
+		initial_offset = gh - 1;
+	}
+
+	kernel = bk_any;
+	if (square && (gw == 7) && (gh == 7))
+		kernel = bk_square_7;
+	else if (square && (gw == 8) && (gh == 8))
+		kernel = bk_square_8;
+	else if (!square && (gw == 5) && (gh == 5))
+		kernel = bk_hex_5;
+
+	// Two padding bits per row - see bitboard.hxx
+	stride = w + 2;
+	bits = h * stride;
+	words = (bits + 63) / 64;
+
+	valid.clear();
+	for (int y = 0; y < h; ++y)
+	{
+		for (int x = 0; x < w; ++x)
+		{
+			if (square || (((x + y) >= (gh - 1)) && ((x + y) <= (w + gh - 2))))
+				valid.set(index(x, y));
+		}
+	}
+
+	// Distances to nearby squares.  Hexagonal boards use an "adjacency map".
+	for (int dy = -2; dy <= 2; ++dy)
+	{
+		for (int dx = -2; dx <= 2; ++dx)
+		{
+			unsigned char d;
+			if ((dx == 0) && (dy == 0))
+				d = 0;
+			else if (!square)
+				d = map[((dy + 2) * 5) + (dx + 2)] - '0';
+			else if ((abs(dx) <= 1) && (abs(dy) <= 1))
+				d = 1;
+			else
+				d = 2;
+			distances[((dy + 2) * 5) + (dx + 2)] = d;
+		}
+	}
+
+	// Build offset lists
+	ringsize[0] = 0;
+	ringsize[1] = 0;
+	cornersize = 0;
+	for (int dy = -2; dy <= 2; ++dy)
+	{
+		for (int dx = -2; dx <= 2; ++dx)
+		{
+			unsigned int d = distance(dx, dy);
+			if (d == 0)
+				continue;
+			int offset = (dy * stride) + dx;
+			ring[d - 1][ringsize[d - 1]++] = offset;
+			if ((d == 2) && (abs(dx) <= 1) && (abs(dy) <= 1))
+				corner[cornersize++] = offset;
+		}
+	}
+
+	// Precompute the neighbours of every square, so that nothing else
+	// needs to range check or look up distances when walking around a
+	// square.  Padding bits and chopped-off corners never appear.
+	for (int d = 0; d < 2; ++d)
+	{
+		first[d].resize(bits + 1);
+		for (int sq = 0; sq < bits; ++sq)
+		{
+			first[d][sq] = neighbours[d].size();
+			if (!valid.test(sq))
+				continue;
+			for (int r = 0; r < ringsize[d]; ++r)
+			{
+				int n = sq + ring[d][r];
+				if ((n >= 0) && (n < bits) && valid.test(n))
+					neighbours[d].push_back(n);
+			}
+		}
+		first[d][bits] = neighbours[d].size();
+	}
+
+	squares = valid.count(words);
+	maxmoves = squares + neighbours[1].size();
+
+	// Try every reflection and rotation of the grid, moved back so that it
+	// covers the same bounding box, and keep those which land every square
+	// on a square.  Hexagonal boards' coordinates are axial (see the
+	// adjacency map): reflections and rotations of a hexagon permute and
+	// negate x, y and -(x + y).
+	symmetries = 0;
+	for (int t = 0; t < (square ? 8 : 12); ++t)
+	{
+		int minx = bits, miny = bits;
+		std::vector<int> tx(bits), ty(bits);
+		for (int sq = 0; sq < bits; ++sq)
+		{
+			if (!valid.test(sq))
+				continue;
+			int c[3] = { xOf(sq), yOf(sq), -(xOf(sq) + yOf(sq)) };
+			if (square)
+			{
+				// Swap x and y or not, and negate either or both
+				int swap = (t >> 2) & 1;
+				tx[sq] = c[swap] * ((t & 1) ? -1 : 1);
+				ty[sq] = c[swap ^ 1] * ((t & 2) ? -1 : 1);
+			} else {
+				// One of the six orders of the three coordinates, negated
+				// or not
+				static const int orders[6][2] = {
+					{ 0, 1 }, { 1, 2 }, { 2, 0 }, { 1, 0 }, { 0, 2 }, { 2, 1 }
+				};
+				int sign = (t & 1) ? -1 : 1;
+				tx[sq] = c[orders[t >> 1][0]] * sign;
+				ty[sq] = c[orders[t >> 1][1]] * sign;
+			}
+			minx = std::min(minx, tx[sq]);
+			miny = std::min(miny, ty[sq]);
+		}
+
+		std::vector<uint16_t> &map = symmetry[symmetries];
+		map.resize(bits);
+		bool fits = true;
+		for (int sq = 0; fits && (sq < bits); ++sq)
+		{
+			map[sq] = sq;
+			if (!valid.test(sq))
+				continue;
+			int x = tx[sq] - minx;
+			int y = ty[sq] - miny;
+			if (contains(x, y))
+				map[sq] = index(x, y);
+			else
+				fits = false;
+		}
+		if (fits)
+			++symmetries;
+	}
+	for (int t = symmetries; t < 12; ++t)
+		symmetry[t].clear();
+
+	for (int t = 0; t < symmetries; ++t)
+	{
+		inverse[t] = 0;
+		for (int u = 0; u < symmetries; ++u)
+		{
+			bool undoes = true;
+			for (int sq = 0; undoes && (sq < bits); ++sq)
+				undoes = (symmetry[u][symmetry[t][sq]] == sq);
+			if (undoes)
+			{
+				inverse[t] = u;
+				break;
+			}
+		}
+	}
+	for (int t = symmetries; t < 12; ++t)
+		inverse[t] = 0;
+}
+
+// Direction of a jump from "source" to "dest", or -1 if there isn't one
+int BoardGeometry::jumpDirection(const int source, const int dest) const
+{
+	if (distance(xOf(dest) - xOf(source), yOf(dest) - yOf(source)) != 2)
+		return -1;
+	for (int r = 0; r < ringsize[1]; ++r)
+	{
+		if (ring[1][r] == dest - source)
+			return r;
+	}
+	return -1;
+}
+
+// Set "out" to every square at exactly the given distance from some
+// square in "in" (which may include squares in "in" itself)
+template <class Board> static KERNEL_INLINE void dilateOn(const BoardGeometry &g, Bitboard &out,
+	const Bitboard &in, const int d)
+{
+	const int words = Board::words(g), size = Board::ringsize(g, d);
+	for (int i = 0; i < words; ++i)
+		out.words[i] = 0;
+	KERNEL_UNROLL
+	for (int r = 0; r < size; ++r)
+		out.orShifted(in, words, Board::ring(g, d, r));
+	for (int i = 0; i < words; ++i)
+		out.words[i] &= g.valid.words[i];
+}
+
+void BoardGeometry::dilate(Bitboard &out, const Bitboard &in, const unsigned int distance) const
+{
+	switch (kernel)
+	{
+		case bk_square_7:
+			dilateOn<FixedBoard<true, 7> >(*this, out, in, distance - 1);
+			break;
+		case bk_square_8:
+			dilateOn<FixedBoard<true, 8> >(*this, out, in, distance - 1);
+			break;
+		case bk_hex_5:
+			dilateOn<FixedBoard<false, 5> >(*this, out, in, distance - 1);
+			break;
+		default:
+			dilateOn<AnyBoard>(*this, out, in, distance - 1);
+	}
+}
+
+// Set "out" to every square within jump distance of some square in "in",
+// and the squares in "in" themselves
+template <class Board> static KERNEL_INLINE void reachOn(const BoardGeometry &g, Bitboard &out,
+	const Bitboard &in)
+{
+	// Squares within jump distance are those within clone distance of
+	// a square within clone distance, whether or not the one in the middle
+	// exists.  Nothing moves more than two columns, so rows don't wrap.
+	const int words = Board::words(g);
+	for (int i = 0; i < words; ++i)
+		out.words[i] = in.words[i];
+	if (g.square)
+	{
+		// Square neighbourhoods can be grown one direction at a time
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			out.orShifted(out, words, 1);
+			out.orShifted(out, words, -1);
+			out.orShifted(out, words, Board::stride(g));
+			out.orShifted(out, words, -Board::stride(g));
+		}
+	} else {
+		const int size = Board::ringsize(g, 0);
+		Bitboard near;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (int i = 0; i < words; ++i)
+				near.words[i] = out.words[i];
+			KERNEL_UNROLL
+			for (int r = 0; r < size; ++r)
+				out.orShifted(near, words, Board::ring(g, 0, r));
+		}
+	}
+	for (int i = 0; i < words; ++i)
+		out.words[i] &= g.valid.words[i];
+}
+
+void BoardGeometry::reach(Bitboard &out, const Bitboard &in) const
+{
+	switch (kernel)
+	{
+		case bk_square_7:
+			reachOn<FixedBoard<true, 7> >(*this, out, in);
+			break;
+		case bk_square_8:
+			reachOn<FixedBoard<true, 8> >(*this, out, in);
+			break;
+		case bk_hex_5:
+			reachOn<FixedBoard<false, 5> >(*this, out, in);
+			break;
+		default:
+			reachOn<AnyBoard>(*this, out, in);
+	}
+}
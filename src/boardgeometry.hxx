@@ -0,0 +1,165 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_BOARDGEOMETRY_HXX
+#define INFECTOR_BOARDGEOMETRY_HXX
+
+// Layouts with bitboard kernels compiled specially for them (see
+// boardkernel.hxx): the standard square board, the one the new game
+// dialogue starts out with, and the smallest hexagonal board
+enum boardkernel
+{
+	bk_any,
+	bk_square_7,
+	bk_square_8,
+	bk_hex_5
+};
+
+// Constant information about the layout of a board of a given shape and size,
+// shared between all BoardStates of that shape.  Squares are numbered row by
+// row as described in bitboard.hxx.
+struct BoardGeometry
+{
+	// Return the geometry for a board of the given shape and size, building
+	// it on first use.  Width and height are as chosen in the new game
+	// dialogue, i.e. for hexagonal boards they are the lengths of the edges.
+	static const BoardGeometry *get(const bool square, const int w, const int h);
+
+	// Can a board of the given shape and size be represented at all?
+	static bool supported(const bool square, const int w, const int h);
+
+	bool square;
+
+	// Dimensions as passed to get()
+	int type_w, type_h;
+
+	// Dimensions of the bounding box (hexagonal boards are stored as a square
+	// with the corners chopped off) and number of bits per row
+	int w, h;
+	int stride;
+
+	// Number of bitboard words & bits needed to cover the bounding box
+	int words;
+	int bits;
+
+	// Vertical offset of the first column (non-zero on hexagonal boards)
+	int initial_offset;
+
+	// Squares which actually exist, and how many of them there are
+	Bitboard valid;
+	int squares;
+
+	// Most moves any player can have at once: one clone into every square,
+	// plus one jump for every pair of squares at jump distance
+	int maxmoves;
+
+	// Offsets, in square indices, to squares at clone (ring 0) and jump
+	// (ring 1) distance.  Each ring is in ascending order, and the same
+	// either way round, so ring[d][ringsize[d] - 1 - r] == -ring[d][r].
+	int ring[2][16];
+	int ringsize[2];
+
+	// Offsets to squares which touch a square's corner in the bounding box
+	// grid, but are at jump distance (only on hexagonal boards)
+	int corner[2];
+	int cornersize;
+
+	// Reflections and rotations which map the board onto itself, as the
+	// square each square is moved to (squares which don't exist stay put).
+	// The identity comes first.  Square boards have up to 8, hexagonal ones
+	// up to 12.
+	std::vector<uint16_t> symmetry[12];
+	int symmetries;
+
+	// Index of the symmetry which undoes each one
+	int inverse[12];
+
+	// Which specially compiled kernels to use, if any
+	boardkernel kernel;
+
+	int index(const int x, const int y) const
+	{
+		return (y * stride) + x;
+	};
+	int xOf(const int sq) const
+	{
+		return sq % stride;
+	};
+	int yOf(const int sq) const
+	{
+		return sq / stride;
+	};
+
+	// Square from which a jump in direction "r" (an index into ring[1])
+	// lands on square "dest"
+	int jumpSource(const int dest, const int r) const
+	{
+		return dest - ring[1][r];
+	};
+
+	// Direction of a jump from "source" to "dest", or -1 if the squares
+	// aren't at jump distance
+	int jumpDirection(const int source, const int dest) const;
+
+	// Is (x, y) a square which exists on this board?
+	bool contains(const int x, const int y) const
+	{
+		return ((x >= 0) && (x < w) && (y >= 0) && (y < h)
+			&& valid.test(index(x, y)));
+	};
+
+	// Shape-dependent distance between two squares (dx, dy) apart.
+	// Return 0 (not adjacent), 1 ("clone" distance) or 2 ("jump" distance)
+	unsigned int distance(const int dx, const int dy) const
+	{
+		if ((dx < -2) || (dx > 2) || (dy < -2) || (dy > 2))
+			return 0;
+		return distances[((dy + 2) * 5) + (dx + 2)];
+	};
+
+	// Squares at exactly the given distance (1 or 2) from square "sq",
+	// as a list of square indices running from begin to end
+	const uint16_t *beginRing(const int sq, const unsigned int distance) const
+	{
+		return neighbours[distance - 1].data() + first[distance - 1][sq];
+	};
+	const uint16_t *endRing(const int sq, const unsigned int distance) const
+	{
+		return neighbours[distance - 1].data() + first[distance - 1][sq + 1];
+	};
+
+	// Set "out" to every square at exactly the given distance from some
+	// square in "in" (which may include squares in "in" itself)
+	void dilate(Bitboard &out, const Bitboard &in, const unsigned int distance) const;
+
+	// Set "out" to every square within jump distance (1 or 2) of some
+	// square in "in", and the squares in "in" themselves
+	void reach(Bitboard &out, const Bitboard &in) const;
+
+	private:
+		BoardGeometry(const bool sq, const int gw, const int gh);
+
+		// Distance lookup for squares up to two apart, indexed as a 5x5 grid
+		unsigned char distances[25];
+
+		// Per-square neighbour lists for each ring, stored back to back, and
+		// the index in each list at which every square's neighbours start
+		std::vector<uint16_t> neighbours[2];
+		std::vector<int> first[2];
+};
+
+#endif
@@ -0,0 +1,148 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_BOARDKERNEL_HXX
+#define INFECTOR_BOARDKERNEL_HXX
+
+// Layouts for bitboard kernels to be compiled against.  Kernels are written
+// once, as templates which get the number of words, row stride and offsets
+// to neighbouring squares from one of these, and instantiated for each
+// layout.  Given a BoardGeometry, the kernel for its layout is picked with
+// a switch on BoardGeometry::kernel.
+//
+// AnyBoard reads everything from the geometry at run time, and works for
+// any board.  FixedBoard knows it all at compile time, so that loops over
+// words and neighbours can be unrolled and every shift is by a constant.
+
+// Loops over neighbours in kernels are marked with KERNEL_UNROLL, to unroll
+// them completely when their bounds are known at compile time.  (GCC only
+// obeys this if the bound is a variable, not a function call.)  Kernels
+// are declared KERNEL_INLINE so that they're compiled into the function
+// which picks between them, for whatever CPU it's being compiled for.
+#if defined(__GNUC__)
+#define KERNEL_UNROLL _Pragma("GCC unroll 16")
+#define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#define KERNEL_UNROLL
+#define KERNEL_INLINE inline
+#endif
+
+// Any board at all
+struct AnyBoard
+{
+	static int words(const BoardGeometry &g)
+	{
+		return g.words;
+	};
+	static int stride(const BoardGeometry &g)
+	{
+		return g.stride;
+	};
+	static int ringsize(const BoardGeometry &g, const int d)
+	{
+		return g.ringsize[d];
+	};
+	static int ring(const BoardGeometry &g, const int d, const int r)
+	{
+		return g.ring[d][r];
+	};
+	static int cornersize(const BoardGeometry &g)
+	{
+		return g.cornersize;
+	};
+	static int corner(const BoardGeometry &g, const int c)
+	{
+		return g.corner[c];
+	};
+};
+
+// The board of the given shape whose sides (as chosen in the new game
+// dialogue) are both "size" squares long.  Offsets are listed in the same
+// order as BoardGeometry builds them, scanning the 5x5 grid around a square
+// row by row; the order isn't important, but makes the two easy to compare.
+template <bool SQUARE, int SIZE> struct FixedBoard
+{
+	enum
+	{
+		W = SQUARE ? SIZE : (2 * SIZE) - 1,
+		STRIDE = W + 2,
+		WORDS = ((W * STRIDE) + 63) / 64
+	};
+
+	static int words(const BoardGeometry &)
+	{
+		return WORDS;
+	};
+	static int stride(const BoardGeometry &)
+	{
+		return STRIDE;
+	};
+	static int ringsize(const BoardGeometry &, const int d)
+	{
+		return SQUARE ? (d ? 16 : 8) : (d ? 12 : 6);
+	};
+	static int ring(const BoardGeometry &, const int d, const int r)
+	{
+		if (SQUARE)
+		{
+			// The 3x3 square around the square, then the 5x5 one
+			if (d == 0)
+			{
+				const int k = (r < 4) ? r : (r + 1);
+				return (((k / 3) - 1) * STRIDE) + (k % 3) - 1;
+			}
+			if (r < 5)
+				return (-2 * STRIDE) + (r - 2);
+			if (r < 11)
+				return ((((r - 5) / 2) - 1) * STRIDE) + (((r - 5) & 1) ? 2 : -2);
+			return (2 * STRIDE) + (r - 13);
+		}
+
+		// See the adjacency map in boardgeometry.cxx
+		switch ((d * 16) + r)
+		{
+			case 0: return -STRIDE;
+			case 1: return -STRIDE + 1;
+			case 2: return -1;
+			case 3: return 1;
+			case 4: return STRIDE - 1;
+			case 5: return STRIDE;
+			case 16: return -2 * STRIDE;
+			case 17: return (-2 * STRIDE) + 1;
+			case 18: return (-2 * STRIDE) + 2;
+			case 19: return -STRIDE - 1;
+			case 20: return -STRIDE + 2;
+			case 21: return -2;
+			case 22: return 2;
+			case 23: return STRIDE - 2;
+			case 24: return STRIDE + 1;
+			case 25: return (2 * STRIDE) - 2;
+			case 26: return (2 * STRIDE) - 1;
+			default: return 2 * STRIDE;
+		}
+	};
+	static int cornersize(const BoardGeometry &)
+	{
+		return SQUARE ? 0 : 2;
+	};
+	static int corner(const BoardGeometry &, const int c)
+	{
+		return c ? (STRIDE + 1) : -(STRIDE + 1);
+	};
+};
+
+#endif
@@ -24,6 +24,9 @@
 #include <config.h>
 
 // Language headers
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <cstdlib>
@@ -32,253 +35,217 @@
 
 // Project headers
 #include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "boardstate.hxx"
-
-//
-// Globals
-//
-
-// "Adjacency map" for hexagonal boards
-static const char *map =
-	"00222"
-	"02112"
-	"21012"
-	"21120"
-	"22200";
+#include "zobrist.hxx"
 
 //
 // Implementation
 //
 
+static_assert(std::is_trivially_copyable<Position>::value,
+	"Position must stay plain data, to be copied around in bulk");
+static_assert(BITBOARD_BITS <= 0x7ff, "square indices must fit in a PackedMove");
+
 BoardState::BoardState(GameType *gt)
-	: current_player(pc_player_1), m_pGameType(gt), xsel(-1), ysel(-1),
-		m_Score1(-1), m_Score2(-1), m_Score3(-1), m_Score4(-1)
+	: current_player(pc_player_1), m_Players((gt->player_3 == pt_none) ? 2 : 4),
+		m_pGeometry(BoardGeometry::get(gt->square, gt->w, gt->h)), xsel(-1), ysel(-1),
+		m_Hash(zobrist_turn[0])
 {
-	if (!(m_pGameType->square))
+	for (int i = 0; i < 4; ++i)
 	{
+		m_Pieces[i].clear();
+		m_Scores[i] = -1;
+	}
+	for (int t = 0; t < 12; ++t)
+		m_Symmetric[t] = 0;
 
-		// Hexagonal board
-		// Store each column with its own unique length and vertical offset, so
-		// that we don't waste any memory.  Basically, we have a square board
-		// with the corners chopped off, where columns are represented as a set
-		// of vectors of unequal length:
-
-		// (0, 0) * / ***** |
-		//         / ****** |
-		// height / ******* |  width
-		//       / ******** |
-		//      / ********* |
-		//        ********
-		//        *******
-		//        ******
-		//        *****   *  ((width + height) - 1, (width + height) - 1)
-		
-		// Number or columns
-		pieces.resize((m_pGameType->w + m_pGameType->h) - 1);
-		// First column is w squares heigh - "height" refers to length of diagonal edge
-		int current_height = m_pGameType->w;
-		// Columns get longer, until the midpoint, then start shrinking again
-		bool growing = true;
-		// Until we get past the midpoint, we also have a vertical offset
-		int current_offset = m_pGameType->h - 1;
-		
-		for (std::vector<std::pair<int, std::vector<piece> > >::iterator i = pieces.begin(); i != pieces.end(); ++i)
-		{
-			i->first = current_offset;
-			i->second.resize(current_height);
-			if (growing)
-			{
-				++current_height;
-				--current_offset;
-				if (current_height == (m_pGameType->w + m_pGameType->h) -1)
-					growing = false;
-			} else {
-				--current_height;
-			}
-		}
-		
-		// Now store the *actual* dimensions of the board, as if it were a square
-		// with the corners cut off.
-		int orig_h = m_pGameType->h;
-		int orig_w = m_pGameType->w;
-		m_pGameType->h = (m_pGameType->w + m_pGameType->h) - 1;
-		m_pGameType->w = m_pGameType->h;
+	if (!(gt->square))
+	{
+		// Hexagonal board - see BoardGeometry for the layout.
+		// The geometry holds the *actual* dimensions of the board, as if it
+		// were a square with the corners cut off; the game type keeps the
+		// lengths of the edges.
+		const int orig_h = gt->h;
+		const int orig_w = gt->w;
+		const int h = m_pGeometry->h;
+		const int w = m_pGeometry->w;
 		
 		// Place starting pieces at the corners.
 		// Can only have two players (fairly) on a hexagonal board, so
 		// don't bother switching based on lastplayer.
-		// We aren't taking into account vertical offsets
-		// here, so zero in the column isn't always zero in the "square".
-		pieces[0].second[0] = pc_player_2;
-		pieces[0].second[orig_w - 1] = pc_player_1;
-		pieces[orig_h - 1].second[0] = pc_player_1;
-		pieces[orig_h - 1].second[m_pGameType->h - 1] = pc_player_2;
-		pieces[m_pGameType->w - 1].second[0] = pc_player_2;
-		pieces[m_pGameType->w - 1].second[orig_w - 1] = pc_player_1;
+		placePiece(0, orig_h - 1, pc_player_2);
+		placePiece(0, h - 1, pc_player_1);
+		placePiece(orig_h - 1, 0, pc_player_1);
+		placePiece(orig_h - 1, h - 1, pc_player_2);
+		placePiece(w - 1, 0, pc_player_2);
+		placePiece(w - 1, orig_w - 1, pc_player_1);
 
 	} else {
 		// Traditional square board with a player at each corner
-		pieces.resize(m_pGameType->w);
-		for (std::vector<std::pair<int, std::vector<piece> > >::iterator i = pieces.begin(); i != pieces.end(); ++i)
-		{
-			i->second.resize(m_pGameType->h);
-			i->first = 0;
-		}
-		
 		// Place starting pieces
 		// Can only have 2 or 4 players on a square board
-		if (m_pGameType->player_3 == pt_none)
+		if (m_Players == 2)
 		{
 			// 2 players
-			pieces[0].second[0] = pc_player_2;
-			pieces[m_pGameType->w - 1].second[m_pGameType->h - 1] = pc_player_2;
-			pieces[0].second[m_pGameType->h - 1] = pc_player_1;
-			pieces[m_pGameType->w - 1].second[0] = pc_player_1;
+			placePiece(0, 0, pc_player_2);
+			placePiece(gt->w - 1, gt->h - 1, pc_player_2);
+			placePiece(0, gt->h - 1, pc_player_1);
+			placePiece(gt->w - 1, 0, pc_player_1);
 		} else {
 			// 4 players
-			pieces[0].second[0] = pc_player_3;
-			pieces[m_pGameType->w - 1].second[m_pGameType->h - 1] = pc_player_2;
-			pieces[0].second[m_pGameType->h - 1] = pc_player_1;
-			pieces[m_pGameType->w - 1].second[0] = pc_player_4;
+			placePiece(0, 0, pc_player_3);
+			placePiece(gt->w - 1, gt->h - 1, pc_player_2);
+			placePiece(0, gt->h - 1, pc_player_1);
+			placePiece(gt->w - 1, 0, pc_player_4);
 		}
 	}
 	
 	// Set initial scores
-	if (m_pGameType->square)
+	if (gt->square)
 	{
-		if (m_pGameType->player_3 == pt_none)
+		if (m_Players == 2)
 		{
-			m_Score1 = 2;
-			m_Score2 = 2;
+			m_Scores[0] = 2;
+			m_Scores[1] = 2;
 		} else {
-			m_Score1 = 1;
-			m_Score2 = 1;
-			m_Score3 = 1;
-			m_Score4 = 1;
+			m_Scores[0] = 1;
+			m_Scores[1] = 1;
+			m_Scores[2] = 1;
+			m_Scores[3] = 1;
 		}
 	} else {
-		m_Score1 = 3;
-		m_Score2 = 3;
+		m_Scores[0] = 3;
+		m_Scores[1] = 3;
+	}
+}
+
+// Set up the board from a snapshot.  Scores and hashes are worked out
+// again from the pieces, as they would have been kept up to date.
+BoardState::BoardState(const Position &p)
+	: current_player((piece)p.player), m_Players(p.players),
+		m_pGeometry(BoardGeometry::get(p.square, p.width, p.height)), xsel(-1), ysel(-1),
+		m_Hash(zobrist_turn[p.player - pc_player_1])
+{
+	const int words = m_pGeometry->words;
+	for (int t = 0; t < 12; ++t)
+		m_Symmetric[t] = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		m_Pieces[i].clear();
+		m_Scores[i] = (i < m_Players) ? p.pieces[i].count(words) : -1;
+		Bitboard squares(p.pieces[i]);
+		for (int sq = squares.pop(words); sq != -1; sq = squares.pop(words))
+		{
+			m_Pieces[i].set(sq);
+			togglePiece(i, sq);
+		}
+	}
+}
+
+// Take a snapshot of the board
+void BoardState::getPosition(Position &out) const
+{
+	memset(&out, 0, sizeof(out));
+	for (int i = 0; i < 4; ++i)
+		out.pieces[i] = m_Pieces[i];
+	out.hash = m_Hash;
+	out.square = m_pGeometry->square;
+	out.width = m_pGeometry->type_w;
+	out.height = m_pGeometry->type_h;
+	out.players = m_Players;
+	out.player = current_player;
+}
+
+// Put a piece on a square without scoring or capturing anything
+void BoardState::placePiece(const int x, const int y, const piece p)
+{
+	int sq = m_pGeometry->index(x, y);
+	m_Pieces[p - pc_player_1].set(sq);
+	togglePiece(p - pc_player_1, sq);
+}
+
+// Add or remove the given player's piece on square "sq" in every hash
+void BoardState::togglePiece(const int p, const int sq)
+{
+	const BoardGeometry &g = *m_pGeometry;
+	m_Hash ^= zobrist_pieces[p][sq];
+	for (int t = 0; t < g.symmetries; ++t)
+		m_Symmetric[t] ^= zobrist_pieces[p][g.symmetry[t][sq]];
+}
+
+// Hash which is the same for every reflection and rotation of the position
+uint64_t BoardState::getCanonicalHash(int &symmetry) const
+{
+	symmetry = 0;
+	for (int t = 1; t < m_pGeometry->symmetries; ++t)
+	{
+		if (m_Symmetric[t] < m_Symmetric[symmetry])
+			symmetry = t;
 	}
+	return m_Symmetric[symmetry] ^ zobrist_turn[current_player - pc_player_1];
 }
 
 // Property accessors
 piece BoardState::getPieceAt(const int x, const int y) const
 {
 	// Take into account unallocated squares in hexagonal board
-	if ((x < 0) || (x >= m_pGameType->w))
-		return pc_no_such_square;
-	int offset_y = y - pieces.at(x).first;
-	if ((offset_y < 0)
-            || (offset_y >= static_cast<int>(pieces.at(x).second.size())))
-    {
+	if (!m_pGeometry->contains(x, y))
 		return pc_no_such_square;
-    }
 
-	return pieces.at(x).second.at(offset_y);
+	return getPieceAt(m_pGeometry->index(x, y));
+}
+
+piece BoardState::getPieceAt(const int sq) const
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		if (m_Pieces[i].test(sq))
+			return (piece)(pc_player_1 + i);
+	}
+	return pc_player_none;
 }
 
 void BoardState::setPieceAt(const int x, const int y, const piece p)
 {
 	// Take into account unallocated squares in hexagonal board
-	if ((x < 0) || (x >= m_pGameType->w))
+	if (!m_pGeometry->contains(x, y))
 		return;
-	int offset_y = y - pieces.at(x).first;
-	if ((offset_y < 0)
-            || (offset_y >= static_cast<int>(pieces.at(x).second.size())))
-    {
-		return;
-    }
-	
-	if (p == pc_player_none)
+
+	// If we're overwriting or clearing out a square, subtract one
+	// from the previous owner's score
+	int sq = m_pGeometry->index(x, y);
+	piece old = getPieceAt(sq);
+	if (old != pc_player_none)
 	{
-		// If we're clearing out a square, subtract one from player's score
-		switch (pieces.at(x).second.at(offset_y))
-		{
-			case pc_player_1:
-				--m_Score1;
-				break;
-			case pc_player_2:
-				--m_Score2;
-				break;
-			case pc_player_3:
-				--m_Score3;
-				break;
-			default:
-				--m_Score4;
-				break;
-		}
+		m_Pieces[old - pc_player_1].reset(sq);
+		--m_Scores[old - pc_player_1];
+		togglePiece(old - pc_player_1, sq);
 	}
-	else
+	if (p == pc_player_none)
+		return;
+
+	// Increase score for the player who's just gained a piece
+	Bitboard &mine = m_Pieces[p - pc_player_1];
+	mine.set(sq);
+	++m_Scores[p - pc_player_1];
+	togglePiece(p - pc_player_1, sq);
+
+	// Capture enemy pieces adjacent to the new one
+	const uint16_t *end = m_pGeometry->endRing(sq, 1);
+	for (const uint16_t *i = m_pGeometry->beginRing(sq, 1); i != end; ++i)
 	{
-		// Increase score for the player who's just gained a piece
-		switch (p)
-		{
-			case pc_player_1:
-				m_Score1++;
-				break;
-			case pc_player_2:
-				m_Score2++;
-				break;
-			case pc_player_3:
-				m_Score3++;
-				break;
-			default:
-				m_Score4++;
-		}
-		
-		// Capture enemy pieces
-		for (int xx = x - 1; xx <= x + 1; ++xx)
-		{
-			int offset = -1;
-			for (int yy = y - 1; yy <= y + 1; ++yy)
-			{
-				piece capturesquare = getPieceAt(xx, yy);
-				if ((capturesquare == pc_player_none) || (capturesquare == pc_no_such_square) || (capturesquare == p))
-				{
-					++offset;
-					continue;
-				}
-				if (getAdjacency(x, y, xx, yy) == 1)
-				{
-					// Enemy piece is adjacent - capture it and update scores
-					int offset_yy = yy - pieces.at(xx).first;
-					pieces[xx].second[offset_yy] = p;
-					switch (capturesquare)
-					{
-						case pc_player_1:
-							m_Score1--;
-							break;
-						case pc_player_2:
-							m_Score2--;
-							break;
-						case pc_player_3:
-							m_Score3--;
-							break;
-						default:
-							m_Score4--;
-					}
-					switch (p)
-					{
-						case pc_player_1:
-							m_Score1++;
-							break;
-						case pc_player_2:
-							m_Score2++;
-							break;
-						case pc_player_3:
-							m_Score3++;
-							break;
-						default:
-							m_Score4++;
-					}
-				}
-				++offset;
-			}
-		}
+		piece capturesquare = getPieceAt(*i);
+		if ((capturesquare == pc_player_none) || (capturesquare == p))
+			continue;
+		m_Pieces[capturesquare - pc_player_1].reset(*i);
+		--m_Scores[capturesquare - pc_player_1];
+		mine.set(*i);
+		++m_Scores[p - pc_player_1];
+		togglePiece(capturesquare - pc_player_1, *i);
+		togglePiece(p - pc_player_1, *i);
 	}
-
-	pieces[x].second[offset_y] = p;
 }
 
 piece BoardState::getPlayer() const
@@ -294,20 +261,14 @@ void BoardState::getSelectedSquare(int &x, int &y) const
 
 int BoardState::getInitialOffset() const
 {
-	return pieces.at(0).first;
+	return m_pGeometry->initial_offset;
 }
 
 void BoardState::setSelectedSquare(const int x, const int y)
 {
 	// Take into account unallocated squares in hexagonal board
-	if ((x < 0) || (x >= m_pGameType->w))
-		return;
-	int offset_y = y - pieces.at(x).first;
-	if ((offset_y < 0)
-            || (offset_y >= static_cast<int>(pieces.at(x).second.size())))
-    {
+	if (!m_pGeometry->contains(x, y))
 		return;
-    }
 
 	xsel = x;
 	ysel = y;
@@ -322,13 +283,15 @@ void BoardState::clearSelection()
 // Advance to the next player's turn and return the new current player
 piece BoardState::nextPlayer()
 {
-	if (((m_pGameType->player_3 == pt_none) && (current_player == pc_player_2))
+	m_Hash ^= zobrist_turn[current_player - pc_player_1];
+	if (((m_Players == 2) && (current_player == pc_player_2))
 		|| (current_player == pc_player_4))
 	{
 		current_player = pc_player_1;
 	} else {
 		current_player = (piece)(current_player + 1);
 	}
+	m_Hash ^= zobrist_turn[current_player - pc_player_1];
 	return current_player;
 }
 
@@ -336,59 +299,12 @@ piece BoardState::nextPlayer()
 // Return 0 (not adjacent), 1 ("clone" distance) or 2 ("jump" distance)
 unsigned int BoardState::getAdjacency(const int ax, const int ay, const int bx, const int by) const
 {
-	// Can't move a piece onto itself
-	if ((ax == bx) && (ay == by))
-		return 0;
-
 	// Range checking, including chopped-off corners on hexagonal board
-
-	if ((ax < 0) || (ax >= m_pGameType->w))
-		return 0;
-	int offset_y = ay - pieces.at(ax).first;
-	if ((offset_y < 0)
-            || (offset_y >= static_cast<int>(pieces.at(ax).second.size())))
-    {
-		return 0;
-    }
-	
-	if ((bx < 0) || (bx >= m_pGameType->w))
+	if (!(m_pGeometry->contains(ax, ay) && m_pGeometry->contains(bx, by)))
 		return 0;
-	offset_y = by - pieces.at(bx).first;
-	if ((offset_y < 0)
-            || (offset_y >= static_cast<int>(pieces.at(bx).second.size())))
-    {
-		return 0;
-    }
 
 	// Now the actual shape-dependent adjacency test
-	if (!(m_pGameType->square))
-	{
-		// Look it up in the adjacency map.
-		// First convert to coordinates in the range (0, 0) to (4, 4)
-		int cx = (bx - ax) + 2;
-		int cy = (by - ay) + 2;
-		if ((cx < 0) || (cx > 4) || (cy < 0) || (cy > 4))
-			return 0;
-		// Then use the span to convert to an index into the linear map
-		int index = (cy * 5) + cx;
-		switch (map[index])
-		{
-			case '1':
-				return 1;
-			case '2':
-				return 2;
-			default:
-				return 0;
-		}		
-	} else {
-		// Square board? simple. :)
-		if ((abs(bx - ax) <= 1) && (abs(by - ay) <= 1))
-			return 1;
-		else if ((abs(bx - ax) <= 2) && (abs(by - ay) <= 2))
-			return 2;
-		else
-			return 0;
-	}
+	return m_pGeometry->distance(bx - ax, by - ay);
 }
 
 // Enumerate available moves for the given player
@@ -396,42 +312,355 @@ unsigned int BoardState::getAdjacency(const int ax, const int ay, const int bx,
 std::vector<move> BoardState::getPossibleMoves(const piece player, const bool stop) const
 {
 	std::vector<move> results;
-	for (int x = 0; x < m_pGameType->w; ++x)
+	const BoardGeometry &g = *m_pGeometry;
+	Bitboard empty;
+	getEmpty(empty);
+
+	// For each of the player's pieces, moves go to any empty square
+	// at clone or jump distance
+	Bitboard sources(m_Pieces[player - pc_player_1]);
+	for (int sq = sources.pop(g.words); sq != -1; sq = sources.pop(g.words))
 	{
-		for (int y = 0; y < m_pGameType->h; ++y)
+		for (unsigned int distance = 1; distance <= 2; ++distance)
 		{
-			if (getPieceAt(x, y) != player)
-				continue;
-			for (int xx = x - 2; xx <= x + 2; ++xx)
+			const uint16_t *end = g.endRing(sq, distance);
+			for (const uint16_t *t = g.beginRing(sq, distance); t != end; ++t)
 			{
-				for (int yy = y - 2; yy <= y + 2; ++yy)
-				{
-					if ((getAdjacency(x, y, xx, yy) > 0)
-						&& (getPieceAt(xx, yy) == pc_player_none))
-					{
-						results.push_back(move(x, y, xx, yy));
-						if (stop)
-							return results;
-					}
-				}
+				if (!empty.test(*t))
+					continue;
+				results.push_back(move(g.xOf(sq), g.yOf(sq), g.xOf(*t), g.yOf(*t)));
+				if (stop)
+					return results;
 			}
 		}
 	}
 	return results;
 }
 
+// Fill "moves", which has room for "capacity" entries, with the moves
+// available to the given player, and return how many were written
+unsigned int BoardState::generateMoves(const piece player, PackedMove *moves,
+	const unsigned int capacity) const
+{
+	const BoardGeometry &g = *m_pGeometry;
+	const Bitboard &mine = m_Pieces[player - pc_player_1];
+	Bitboard empty, targets;
+	getEmpty(empty);
+	unsigned int n = 0;
+
+	// Clones - every empty square next to at least one of our pieces
+	g.dilate(targets, mine, 1);
+	for (int i = 0; i < g.words; ++i)
+		targets.words[i] &= empty.words[i];
+	for (int t = targets.pop(g.words); t != -1; t = targets.pop(g.words))
+	{
+		if (n == capacity)
+			return n;
+		moves[n++] = PackedMove(t);
+	}
+
+	// Jumps - every empty square at jump distance from each of our pieces.
+	// Squares off the board are never empty, so only the ends of the board
+	// need checking.
+	Bitboard sources(mine);
+	for (int sq = sources.pop(g.words); sq != -1; sq = sources.pop(g.words))
+	{
+		for (int r = 0; r < g.ringsize[1]; ++r)
+		{
+			const int t = sq + g.ring[1][r];
+			if ((t < 0) || (t >= g.bits) || !empty.test(t))
+				continue;
+			if (n == capacity)
+				return n;
+			moves[n++] = PackedMove(t, r);
+		}
+	}
+	return n;
+}
+
+// Convert a move for the current player to its packed form
+PackedMove BoardState::packMove(const move &m) const
+{
+	const BoardGeometry &g = *m_pGeometry;
+	const int dest = g.index(m.dest_x, m.dest_y);
+	if (g.distance(m.dest_x - m.source_x, m.dest_y - m.source_y) == 1)
+		return PackedMove(dest);
+	return PackedMove(dest, g.jumpDirection(g.index(m.source_x, m.source_y), dest));
+}
+
+// Convert a packed move for the current player back again
+move BoardState::unpackMove(const PackedMove m) const
+{
+	const BoardGeometry &g = *m_pGeometry;
+	const int dest = m.dest();
+	int source;
+	if (m.isClone())
+	{
+		const Bitboard &mine = m_Pieces[current_player - pc_player_1];
+		const uint16_t *s = g.beginRing(dest, 1);
+		while (!mine.test(*s))
+			++s;
+		source = *s;
+	} else {
+		source = g.jumpSource(dest, m.direction());
+	}
+	return move(g.xOf(source), g.yOf(source), g.xOf(dest), g.yOf(dest));
+}
+
+// Make a move for the current player and advance to the next player's turn
+MoveUndo BoardState::makeMove(const PackedMove m)
+{
+	const BoardGeometry &g = *m_pGeometry;
+	const int me = current_player - pc_player_1;
+	Bitboard &mine = m_Pieces[me];
+
+	MoveUndo u;
+	u.player = current_player;
+	u.pass = false;
+	u.dest = m.dest();
+	u.jump = !m.isClone();
+	u.source = u.jump ? g.jumpSource(u.dest, m.direction()) : u.dest;
+	u.captured = 0;
+	u.owners = 0;
+	for (int i = 0; i < 4; ++i)
+		u.deltas[i] = 0;
+	u.hash = m_Hash;
+
+	// Jumps move the piece; clones gain one
+	if (u.jump)
+	{
+		mine.reset(u.source);
+		togglePiece(me, u.source);
+	} else {
+		++u.deltas[me];
+	}
+	mine.set(u.dest);
+	togglePiece(me, u.dest);
+
+	// Capture enemy pieces adjacent to the destination
+	int bit = 0;
+	const uint16_t *end = g.endRing(u.dest, 1);
+	for (const uint16_t *i = g.beginRing(u.dest, 1); i != end; ++i, ++bit)
+	{
+		for (int p = 0; p < 4; ++p)
+		{
+			if ((p == me) || !m_Pieces[p].test(*i))
+				continue;
+			m_Pieces[p].reset(*i);
+			mine.set(*i);
+			u.captured |= 1 << bit;
+			u.owners |= p << (bit * 2);
+			--u.deltas[p];
+			++u.deltas[me];
+			togglePiece(p, *i);
+			togglePiece(me, *i);
+			break;
+		}
+	}
+
+	for (int i = 0; i < 4; ++i)
+		m_Scores[i] += u.deltas[i];
+	nextPlayer();
+	return u;
+}
+
+// Pass the current player's turn
+MoveUndo BoardState::makePass()
+{
+	MoveUndo u;
+	u.player = current_player;
+	u.pass = true;
+	u.hash = m_Hash;
+	nextPlayer();
+	return u;
+}
+
+// Take back the most recent move or pass.  The symmetric hashes are put
+// back by toggling the same pieces again, which also changes the main hash,
+// so that's restored afterwards.
+void BoardState::unmakeMove(const MoveUndo &u)
+{
+	current_player = u.player;
+	if (u.pass)
+	{
+		m_Hash = u.hash;
+		return;
+	}
+
+	const BoardGeometry &g = *m_pGeometry;
+	const int me = u.player - pc_player_1;
+	Bitboard &mine = m_Pieces[me];
+
+	// Give captured pieces back
+	int bit = 0;
+	const uint16_t *end = g.endRing(u.dest, 1);
+	for (const uint16_t *i = g.beginRing(u.dest, 1); i != end; ++i, ++bit)
+	{
+		if (!(u.captured & (1 << bit)))
+			continue;
+		int owner = (u.owners >> (bit * 2)) & 3;
+		mine.reset(*i);
+		m_Pieces[owner].set(*i);
+		togglePiece(me, *i);
+		togglePiece(owner, *i);
+	}
+
+	mine.reset(u.dest);
+	togglePiece(me, u.dest);
+	if (u.jump)
+	{
+		mine.set(u.source);
+		togglePiece(me, u.source);
+	}
+	m_Hash = u.hash;
+
+	for (int i = 0; i < 4; ++i)
+		m_Scores[i] -= u.deltas[i];
+}
+
+unsigned int BoardState::getMaxMoves() const
+{
+	return m_pGeometry->maxmoves;
+}
+
 // Can the given player actually move?
 // A player can move if there is an empty square within a
 // distance of 2 from one of their pieces.
 bool BoardState::canMove(const piece player) const
 {
-	return (getPossibleMoves(player, true).size() > 0);
+	const BoardGeometry &g = *m_pGeometry;
+	Bitboard empty, targets;
+	getEmpty(empty);
+	g.reach(targets, m_Pieces[player - pc_player_1]);
+	for (int i = 0; i < g.words; ++i)
+	{
+		if (targets.words[i] & empty.words[i])
+			return true;
+	}
+	return false;
+}
+
+// Which players can move?  Distances work both ways, so these are the
+// players with pieces within a distance of 2 of any empty square.
+unsigned int BoardState::getMobilePlayers() const
+{
+	const BoardGeometry &g = *m_pGeometry;
+	Bitboard empty, sources;
+	getEmpty(empty);
+	g.reach(sources, empty);
+
+	unsigned int mobile = 0;
+	for (int p = 0; p < 4; ++p)
+	{
+		for (int i = 0; i < g.words; ++i)
+		{
+			if (m_Pieces[p].words[i] & sources.words[i])
+			{
+				mobile |= 1 << p;
+				break;
+			}
+		}
+	}
+	return mobile;
+}
+
+// Having just made a move for "mover" and advanced to the next player,
+// skip the turns of any players who can't move.  Return false if the
+// game has ended.
+bool BoardState::skipBlockedPlayers(const piece mover)
+{
+	// Nobody's pieces change while we're doing this
+	unsigned int mobile = getMobilePlayers();
+	while (!(mobile & (1 << (current_player - pc_player_1))))
+	{
+		if (nextPlayer() == mover)
+			return false;
+	}
+	return true;
+}
+
+// Make all remaining empty squares be owned by the given player.  Filling
+// squares one at a time would capture any enemy pieces next to them, and no
+// enemy pieces are ever created by doing so, so the end result is the same
+// whatever order it's done in.
+void BoardState::fillEmpty(const piece p)
+{
+	const BoardGeometry &g = *m_pGeometry;
+	Bitboard empty, taken;
+	getEmpty(empty);
+	g.dilate(taken, empty, 1);
+	for (int i = 0; i < g.words; ++i)
+		taken.words[i] |= empty.words[i];
+
+	Bitboard &mine = m_Pieces[p - pc_player_1];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == p - pc_player_1)
+			continue;
+		int captured = 0;
+		for (int j = 0; j < g.words; ++j)
+		{
+			uint64_t c = m_Pieces[i].words[j] & taken.words[j];
+			m_Pieces[i].words[j] &= ~c;
+			captured += __builtin_popcountll(c);
+			for (; c; c &= c - 1)
+				togglePiece(i, (j << 6) + __builtin_ctzll(c));
+		}
+		m_Scores[i] -= captured;
+		m_Scores[p - pc_player_1] += captured;
+	}
+	for (int j = 0; j < g.words; ++j)
+	{
+		for (uint64_t c = taken.words[j] & ~mine.words[j]; c; c &= c - 1)
+			togglePiece(p - pc_player_1, (j << 6) + __builtin_ctzll(c));
+		mine.words[j] |= taken.words[j];
+	}
+	m_Scores[p - pc_player_1] += empty.count(g.words);
+}
+
+void BoardState::getFilledScores(const piece p, int& p1, int& p2, int& p3, int& p4) const
+{
+	const BoardGeometry &g = *m_pGeometry;
+	Bitboard empty, taken;
+	getEmpty(empty);
+	g.dilate(taken, empty, 1);
+
+	int scores[4];
+	for (int i = 0; i < 4; ++i)
+		scores[i] = m_Scores[i];
+	for (int i = 0; i < 4; ++i)
+	{
+		if (i == p - pc_player_1)
+			continue;
+		int captured = 0;
+		for (int j = 0; j < g.words; ++j)
+			captured += __builtin_popcountll(m_Pieces[i].words[j] & taken.words[j]);
+		scores[i] -= captured;
+		scores[p - pc_player_1] += captured;
+	}
+	scores[p - pc_player_1] += empty.count(g.words);
+
+	p1 = scores[0];
+	p2 = scores[1];
+	p3 = scores[2];
+	p4 = scores[3];
 }
 
 void BoardState::getScores(int& p1, int& p2, int& p3, int& p4) const
 {
-	p1 = m_Score1;
-	p2 = m_Score2;
-	p3 = m_Score3;
-	p4 = m_Score4;
+	p1 = m_Scores[0];
+	p2 = m_Scores[1];
+	p3 = m_Scores[2];
+	p4 = m_Scores[3];
+}
+
+// Set "out" to the squares which exist but contain no piece
+void BoardState::getEmpty(Bitboard &out) const
+{
+	for (int i = 0; i < m_pGeometry->words; ++i)
+	{
+		out.words[i] = m_pGeometry->valid.words[i]
+			& ~(m_Pieces[0].words[i] | m_Pieces[1].words[i]
+				| m_Pieces[2].words[i] | m_Pieces[3].words[i]);
+	}
 }
@@ -19,8 +19,10 @@
 #define INFECTOR_BOARDSTATE_HXX
 
 class Game;
+struct BoardGeometry;
 
-// Struct for storing a single game move
+// Struct for storing a single game move, as shown on screen and sent over
+// the network
 struct move
 {
 	int source_x;
@@ -33,13 +35,110 @@ struct move
 	move() {};
 };
 
+// Compact form of a move, as the AI stores them: the destination square's
+// index (see BoardGeometry) in the low 11 bits, and how the move got there
+// in the top 5.  Cloning into a square has the same result whichever piece
+// it's from, so clones have no source, and 0 in the top bits; otherwise the
+// move is a jump in direction n - 1 (see BoardGeometry::jumpSource).  Use
+// BoardState::packMove and unpackMove to convert to and from a move.
+struct PackedMove
+{
+	uint16_t bits;
+
+	// A clone into "dest", or a jump into it in direction "r"
+	explicit PackedMove(const int dest, const int r = -1)
+		: bits(dest | ((r + 1) << 11))
+	{};
+	PackedMove() {};
+
+	// Stands for no move at all, e.g. when a position has no best move
+	static PackedMove none()
+	{
+		return PackedMove(0x7ff, 30);
+	};
+
+	int dest() const
+	{
+		return bits & 0x7ff;
+	};
+	bool isClone() const
+	{
+		return (bits >> 11) == 0;
+	};
+	// Direction of a jump
+	int direction() const
+	{
+		return (bits >> 11) - 1;
+	};
+
+	bool operator==(const PackedMove &m) const
+	{
+		return bits == m.bits;
+	};
+	bool operator!=(const PackedMove &m) const
+	{
+		return bits != m.bits;
+	};
+};
+
+// Struct for storing everything needed to take back a move made with
+// BoardState::makeMove
+struct MoveUndo
+{
+	// Player who made the move
+	piece player;
+	// Whether the player passed instead of moving
+	bool pass;
+	// Whether the move was a jump, which vacated the source square
+	bool jump;
+	uint16_t source;
+	uint16_t dest;
+	// Bit n is set if the n'th square at clone distance from the destination
+	// was captured, in which case bits 2n and 2n + 1 of "owners" hold the
+	// index (from player 1) of the player it was captured from
+	uint8_t captured;
+	uint16_t owners;
+	// Change in each player's score
+	int8_t deltas[4];
+	// Hash of the position before the move
+	uint64_t hash;
+};
+
+// Snapshot of a BoardState as plain data: fixed size, with no pointers or
+// heap storage, so that it can be copied with memcpy, kept in arrays or
+// written to files, and compared or hashed byte by byte (bytes which aren't
+// in use are always zero).  Turn it back into a BoardState to play on it.
+struct Position
+{
+	// Each player's pieces, as BoardState::getPieces()
+	Bitboard pieces[4];
+	// Zobrist hash, as BoardState::getHash()
+	uint64_t hash;
+	// Shape and size of the board, as given to BoardGeometry::get()
+	uint8_t square;
+	uint8_t width;
+	uint8_t height;
+	// Number of players (2 or 4), and whose turn it is
+	uint8_t players;
+	uint8_t player;
+	uint8_t unused[3];
+};
+
 class BoardState
 {
 	public:
 		BoardState(GameType *gt);
+
+		// Set up the board as it was when the snapshot was taken
+		explicit BoardState(const Position &p);
+
+		// Take a snapshot of the board, leaving out the selected square
+		void getPosition(Position &out) const;
 		
 		// Property accessors
 		piece getPieceAt(const int x, const int y) const;
+		// Same again, given a square index (see BoardGeometry)
+		piece getPieceAt(const int sq) const;
 		void setPieceAt(const int x, const int y, const piece p);
 		piece getPlayer() const;
 		void getSelectedSquare(int &x, int &y) const;
@@ -59,24 +158,140 @@ class BoardState
 		// Set "stop" to true to stop as soon as one move is found
 		std::vector<move> getPossibleMoves(const piece player, const bool stop = false) const;
 
+		// Fill "moves", which has room for "capacity" entries, with the moves
+		// available to the given player, and return how many were written.
+		// Each empty square the player can clone into is listed once; all
+		// the jumps follow the clones.
+		unsigned int generateMoves(const piece player, PackedMove *moves,
+			const unsigned int capacity) const;
+
+		// Convert a move for the current player to and from its packed form.
+		// Unpacking a clone picks the first of the player's pieces found
+		// next to the destination as its source.
+		PackedMove packMove(const move &m) const;
+		move unpackMove(const PackedMove m) const;
+
+		// Make a move for the current player and advance to the next player's
+		// turn (whether or not they can move), returning what's needed to
+		// take it back again.  The move must be valid.
+		MoveUndo makeMove(const PackedMove m);
+
+		// Pass the current player's turn
+		MoveUndo makePass();
+
+		// Take back the most recent move or pass, restoring the exact state
+		// from before it was made
+		void unmakeMove(const MoveUndo &u);
+
+		// Room needed for generateMoves to list every move on this board
+		unsigned int getMaxMoves() const;
+
 		// Can the given player actually move?
 		bool canMove(const piece player) const;
 
+		// Which players can move, as a bit mask with bit 0 for player 1
+		unsigned int getMobilePlayers() const;
+
+		// Having just made a move for "mover" and advanced to the next player,
+		// skip the turns of any players who can't move.  If we come full
+		// circle, the game has ended: return false, with the turn back at
+		// "mover".
+		bool skipBlockedPlayers(const piece mover);
+
+		// At the end of the game, make all remaining empty squares be owned by
+		// the given player, capturing enemy pieces next to them as if they'd
+		// been filled one at a time.
+		void fillEmpty(const piece p);
+
 		// Get current scores
 		void getScores(int& p1, int& p2, int& p3, int& p4) const;
+
+		// Get the scores fillEmpty would leave behind, without changing
+		// anything
+		void getFilledScores(const piece p, int& p1, int& p2, int& p3, int& p4) const;
+
+		// Direct access to the underlying bitboards, for code which wants
+		// to work on whole sets of squares at a time
+		const BoardGeometry *getGeometry() const
+		{
+			return m_pGeometry;
+		};
+		const Bitboard &getPieces(const piece player) const
+		{
+			return m_Pieces[player - pc_player_1];
+		};
+		void getEmpty(Bitboard &out) const;
+
+		// Zobrist hash of the pieces on the board and the player to move
+		// (see zobrist.hxx), for recognising positions seen before
+		uint64_t getHash() const
+		{
+			return m_Hash;
+		};
+
+		// Hash which is the same for every reflection and rotation of the
+		// position (see symmetry.hxx), and which of the board's symmetries
+		// turns this position into the canonical one it was computed from
+		uint64_t getCanonicalHash(int &symmetry) const;
 		
 	private:
 		// Game info
 		piece current_player;
-		GameType *m_pGameType;
+		int m_Players;
+		const BoardGeometry *m_pGeometry;
 
-		// Board state - store each column with an explicit vertical offset (for
-		// supporting hexagonal boards)
-		std::vector<std::pair<int, std::vector<piece> > > pieces;
+		// Board state - one set of squares per player.  Squares which exist
+		// on the board but aren't in any of the sets are empty.
+		Bitboard m_Pieces[4];
 		int xsel, ysel;
 
-		// Scores
-		int m_Score1, m_Score2, m_Score3, m_Score4;
+		// Scores, indexed from player 1
+		int m_Scores[4];
+
+		// Hash of the current position, kept up to date as it changes
+		uint64_t m_Hash;
+
+		// Hashes of just the pieces, as they'd be after each of the board's
+		// symmetries, also kept up to date
+		uint64_t m_Symmetric[12];
+
+		// Put a piece on a square without scoring or capturing anything
+		void placePiece(const int x, const int y, const piece p);
+
+		// Add or remove the given player's piece on square "sq" in every hash
+		void togglePiece(const int p, const int sq);
+};
+
+// Most moves a player can have on any board a bitboard can hold: a clone into
+// every square, plus jumps into it from up to 16 others
+#define MAX_MOVES (BITBOARD_BITS * 17)
+
+// Fixed-capacity list of packed moves, as plain data which can live on the
+// stack and be copied in one go.  The default capacity is enough for any
+// board; given less, generate() keeps as many moves as fit.
+template <unsigned int CAPACITY = MAX_MOVES> struct MoveList
+{
+	unsigned int size;
+	PackedMove moves[CAPACITY];
+
+	// Fill the list with the moves of the player whose turn it is
+	void generate(const BoardState &b)
+	{
+		size = b.generateMoves(b.getPlayer(), moves, CAPACITY);
+	};
+
+	PackedMove operator[](const unsigned int i) const
+	{
+		return moves[i];
+	};
+	const PackedMove *begin() const
+	{
+		return moves;
+	};
+	const PackedMove *end() const
+	{
+		return moves + size;
+	};
 };
 
 #endif
@@ -0,0 +1,212 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// System headers
+#ifndef MINGW
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "book.hxx"
+#include "symmetry.hxx"
+
+//
+// Globals
+//
+
+static const char book_magic[8] = { 'I', 'N', 'F', 'B', 'O', 'O', 'K', 2 };
+
+//
+// Implementation
+//
+
+OpeningBook::OpeningBook()
+	: m_pEntries(NULL), m_Count(0), m_pMapping(NULL), m_MappingSize(0)
+{
+}
+
+OpeningBook::~OpeningBook()
+{
+	close();
+}
+
+bool OpeningBook::open(const char *filename)
+{
+	close();
+
+	// The header and entries are all multiples of 8 bytes long, and
+	// mappings and copies start on a page or uint64_t boundary, so
+	// everything can be read in place
+	const char *data = NULL;
+	size_t size = 0;
+#ifdef MINGW
+	FILE *f = fopen(filename, "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	long len = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if (len >= 16)
+	{
+		m_pCopy.reset(new uint64_t[(len + 7) / 8]);
+		if (fread(m_pCopy.get(), 1, len, f) == (size_t)len)
+		{
+			data = (const char*)m_pCopy.get();
+			size = len;
+		}
+	}
+	fclose(f);
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if ((fstat(fd, &st) == 0) && (st.st_size >= 16))
+	{
+		void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			m_pMapping = p;
+			m_MappingSize = st.st_size;
+			data = (const char*)p;
+			size = st.st_size;
+		}
+	}
+	::close(fd);
+#endif
+
+	if (!data)
+	{
+		close();
+		return false;
+	}
+	uint64_t count;
+	memcpy(&count, data + 8, sizeof(count));
+	if ((memcmp(data, book_magic, 8) != 0)
+		|| (count > ((size - 16) / sizeof(BookEntry))))
+	{
+		close();
+		return false;
+	}
+	m_pEntries = (const BookEntry*)(data + 16);
+	m_Count = count;
+	return true;
+}
+
+void OpeningBook::close()
+{
+#ifndef MINGW
+	if (m_pMapping)
+		munmap(m_pMapping, m_MappingSize);
+#endif
+	m_pMapping = NULL;
+	m_MappingSize = 0;
+	m_pCopy.reset();
+	m_pEntries = NULL;
+	m_Count = 0;
+}
+
+// Find the book move for the current player
+bool OpeningBook::probe(const BoardState &b, PackedMove &m, int &score) const
+{
+	if (m_Count == 0)
+		return false;
+
+	int t;
+	uint64_t key = canonicalKey(b, t);
+	const BookEntry *end = m_pEntries + m_Count;
+	const BookEntry *e = std::lower_bound(m_pEntries, end, key,
+		[](const BookEntry &a, const uint64_t k) { return a.key < k; });
+	if ((e == end) || (e->key != key))
+		return false;
+
+	// Turn the move back round to match the board
+	const BoardGeometry &g = *b.getGeometry();
+	if ((e->source >= g.bits) || (e->dest >= g.bits))
+		return false;
+	int source = fromCanonical(g, t, e->source);
+	int dest = fromCanonical(g, t, e->dest);
+	if (!g.valid.test(source) || !g.valid.test(dest))
+		return false;
+	switch (g.distance(g.xOf(dest) - g.xOf(source), g.yOf(dest) - g.yOf(source)))
+	{
+		case 1:
+			m = PackedMove(dest);
+			break;
+		case 2:
+			m = PackedMove(dest, g.jumpDirection(source, dest));
+			break;
+		default:
+			return false;
+	}
+	score = e->score;
+	return true;
+}
+
+// Key for the given position, the same for all its reflections and rotations
+uint64_t OpeningBook::canonicalKey(const BoardState &b, int &symmetry)
+{
+	const BoardGeometry &g = *b.getGeometry();
+
+	// Tell boards apart by shape and size, since square indices mean
+	// different things on each
+	uint64_t board = ((uint64_t)g.square << 32) | ((uint64_t)g.type_w << 16) | g.type_h;
+	board = (board ^ (board >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	board = (board ^ (board >> 27)) * 0x94d049bb133111ebULL;
+	return board ^ b.getCanonicalHash(symmetry);
+}
+
+// Write a book containing the given entries
+bool OpeningBook::write(const char *filename, std::vector<BookEntry> &entries)
+{
+	std::sort(entries.begin(), entries.end(),
+		[](const BookEntry &a, const BookEntry &b) { return a.key < b.key; });
+
+	FILE *f = fopen(filename, "wb");
+	if (!f)
+		return false;
+	uint64_t count = entries.size();
+	bool ok = (fwrite(book_magic, 1, 8, f) == 8)
+		&& (fwrite(&count, sizeof(count), 1, f) == 1)
+		&& (entries.empty()
+			|| (fwrite(entries.data(), sizeof(BookEntry), count, f) == count));
+	return (fclose(f) == 0) && ok;
+}
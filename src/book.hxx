@@ -0,0 +1,94 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_BOOK_HXX
+#define INFECTOR_BOOK_HXX
+
+class BoardState;
+
+// One position in an opening book: its key (see OpeningBook::canonicalKey),
+// and the move to play and the score the search gave it.  The move's squares
+// are in the position's canonical orientation.  Moves are kept as a pair of
+// squares, rather than packed, so that books don't depend on the order of
+// BoardGeometry's jump directions.
+struct BookEntry
+{
+	uint64_t key;
+	uint16_t source;
+	uint16_t dest;
+	int32_t score;
+};
+
+// Precomputed moves for positions near the start of the game, so the AI
+// needn't think about the same few openings afresh every game.
+//
+// A book file is a 16 byte header - the magic string "INFBOOK", a format
+// version byte, and the number of entries as a 64-bit integer - followed by
+// the entries sorted by key, all in the machine's own byte order.  Books
+// are mapped into memory as they are and searched in place, so opening one
+// costs nothing however big it is.
+//
+// Positions are stored once however they're reflected or rotated: keys are
+// computed from whichever orientation has the lowest hash.  They also
+// depend on the shape and size of the board, so one book can hold openings
+// for any number of boards.
+class OpeningBook
+{
+	public:
+		OpeningBook();
+		~OpeningBook();
+
+		// Map in the book in the given file, in place of any already open.
+		// Returns false, leaving the book empty, if the file can't be read
+		// or isn't a book.
+		bool open(const char *filename);
+
+		// Forget the book's contents
+		void close();
+
+		// Number of positions in the book
+		size_t getSize() const
+		{
+			return m_Count;
+		};
+
+		// Find the book move for the current player, if the position is in
+		// the book, along with the score it was given
+		bool probe(const BoardState &b, PackedMove &m, int &score) const;
+
+		// Key for the given position, the same for all its reflections and
+		// rotations, and which of the board's symmetries (see BoardGeometry)
+		// turns it into the orientation the key was computed from
+		static uint64_t canonicalKey(const BoardState &b, int &symmetry);
+
+		// Write a book containing the given entries, sorting them first.
+		// Returns false if the file can't be written.
+		static bool write(const char *filename, std::vector<BookEntry> &entries);
+
+	private:
+		// Entries, sorted by key
+		const BookEntry *m_pEntries;
+		size_t m_Count;
+
+		// The file's contents: either a memory mapping, or on systems
+		// without mmap(), a copy
+		void *m_pMapping;
+		size_t m_MappingSize;
+		std::unique_ptr<uint64_t[]> m_pCopy;
+};
+
+#endif
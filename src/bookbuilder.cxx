@@ -0,0 +1,253 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+// Opening book builder: search every position within a few moves of the
+// start of the game, for as long as we like, and write the best moves found
+// out as a book for the AI to play from.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "search.hxx"
+#include "transposition.hxx"
+#include "book.hxx"
+#include "symmetry.hxx"
+
+//
+// Implementation
+//
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [options] FILE\n"
+		"  -B LIST    boards to build openings for, comma separated\n"
+		"             (default \"sq7\")\n"
+		"  -d PLIES   include every position up to this many moves in\n"
+		"             (default 2)\n"
+		"  -t MS      thinking time per position (default 2000)\n"
+		"  -H MB      transposition table size per thread (default 32)\n"
+		"  -j JOBS    positions to search at once (default: one per CPU)\n"
+		"Boards are \"sqN\" or \"hexN\", with \"/4\" appended for four\n"
+		"players (square boards only).\n",
+		argv0);
+}
+
+static bool parseBoard(const std::string &text, GameType &gt)
+{
+	const char *c = text.c_str();
+	if (strncmp(c, "sq", 2) == 0)
+	{
+		gt.square = true;
+		c += 2;
+	} else if (strncmp(c, "hex", 3) == 0) {
+		gt.square = false;
+		c += 3;
+	} else {
+		return false;
+	}
+	char *end;
+	gt.w = gt.h = strtol(c, &end, 10);
+	gt.player_1 = pt_ai;
+	gt.player_2 = pt_ai;
+	if (strcmp(end, "/4") == 0)
+	{
+		if (!gt.square)
+			return false;
+		gt.player_3 = pt_ai;
+		gt.player_4 = pt_ai;
+	}
+	else if (*end != '\0')
+		return false;
+	return BoardGeometry::supported(gt.square, gt.w, gt.h);
+}
+
+// Add the given position and everything reachable from it in "plies" more
+// moves to the list, once each however it's reflected or rotated
+static void collect(const BoardState &b, const int plies, std::set<uint64_t> &seen,
+	std::vector<Position> &positions)
+{
+	int t;
+	if (!seen.insert(OpeningBook::canonicalKey(b, t)).second)
+		return;
+	positions.push_back(Position());
+	b.getPosition(positions.back());
+	if (plies == 0)
+		return;
+
+	MoveList<> moves;
+	moves.generate(b);
+	for (unsigned int i = 0; i < moves.size; ++i)
+	{
+		BoardState child(b);
+		piece p = child.getPlayer();
+		child.makeMove(moves[i]);
+		if (child.skipBlockedPlayers(p))
+			collect(child, plies - 1, seen, positions);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	std::string boards("sq7");
+	int plies = 2;
+	int ms = 2000;
+	int hash = 32;
+	unsigned int jobs = std::thread::hardware_concurrency();
+
+	int i = 1;
+	for (; (i < argc) && (argv[i][0] == '-'); ++i)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = (value != NULL);
+		if (ok && (strcmp(argv[i], "-B") == 0))
+			boards = value;
+		else if (ok && (strcmp(argv[i], "-d") == 0))
+			ok = ((plies = atoi(value)) >= 0);
+		else if (ok && (strcmp(argv[i], "-t") == 0))
+			ok = ((ms = atoi(value)) > 0);
+		else if (ok && (strcmp(argv[i], "-H") == 0))
+			ok = ((hash = atoi(value)) > 0);
+		else if (ok && (strcmp(argv[i], "-j") == 0))
+		{
+			// Checked before it goes into "jobs", which is unsigned
+			const int n = atoi(value);
+			ok = (n > 0);
+			if (ok)
+				jobs = n;
+		}
+		else
+			ok = false;
+		if (!ok)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+	if (i != argc - 1)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	const char *filename = argv[i];
+	if (jobs == 0)
+		jobs = 1;
+
+	// Positions are stored as snapshots, which don't depend on the game
+	// type they came from
+	std::vector<Position> positions;
+	std::set<uint64_t> seen;
+	size_t pos = 0;
+	while (pos < boards.size())
+	{
+		size_t comma = boards.find(',', pos);
+		if (comma == std::string::npos)
+			comma = boards.size();
+		std::string text(boards, pos, comma - pos);
+		pos = comma + 1;
+
+		GameType gt;
+		if (!parseBoard(text, gt))
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		size_t before = positions.size();
+		collect(BoardState(&gt), plies, seen, positions);
+		printf("%s: %lu positions\n", text.c_str(), (unsigned long)(positions.size() - before));
+	}
+
+	// Positions are handed out to worker threads one at a time, each with
+	// its own search
+	std::vector<BookEntry> entries;
+	std::atomic<size_t> next(0);
+	std::mutex lock;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::vector<std::thread> workers;
+	for (unsigned int j = 0; j < std::min(jobs, (unsigned int)positions.size()); ++j)
+	{
+		workers.push_back(std::thread([&, j]()
+		{
+			TranspositionTable tt(hash);
+			Search search;
+			search.setThreads(1);
+			search.setTimeBudget(ms);
+			search.setTranspositionTable(&tt);
+			search.setSeed(j);
+			for (size_t k = next++; k < positions.size(); k = next++)
+			{
+				const BoardState b(positions[k]);
+				PackedMove best;
+				if (!search.findMove(b, best))
+					continue;
+
+				BookEntry e;
+				int t;
+				e.key = OpeningBook::canonicalKey(b, t);
+				const BoardGeometry &g = *b.getGeometry();
+				move m = b.unpackMove(best);
+				e.source = toCanonical(g, t, g.index(m.source_x, m.source_y));
+				e.dest = toCanonical(g, t, g.index(m.dest_x, m.dest_y));
+				e.score = search.getScore();
+
+				std::lock_guard<std::mutex> guard(lock);
+				entries.push_back(e);
+				printf("\r%lu/%lu", (unsigned long)entries.size(),
+					(unsigned long)positions.size());
+				fflush(stdout);
+			}
+		}));
+	}
+	for (size_t j = 0; j < workers.size(); ++j)
+		workers[j].join();
+
+	double elapsed = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	printf("\rsearched %lu positions in %.1fs\n", (unsigned long)entries.size(), elapsed);
+	if (!OpeningBook::write(filename, entries))
+	{
+		fprintf(stderr, "Couldn't write %s\n", filename);
+		return 1;
+	}
+	return 0;
+}
@@ -25,6 +25,8 @@
 #include "infector-i18n.hxx"
 
 // Language headers
+#include <cstdint>
+#include <vector>
 #include <cerrno>
 #include <cstring>
 #include <sstream>
@@ -44,6 +46,8 @@
 
 // Project headers
 #include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "socket.hxx"
 #include "clientstatusdialog.hxx"
 
@@ -284,8 +288,8 @@ bool ClientStatusDialog::handleServerSock(Glib::IOCondition cond)
 					// with other than two players, has any unrecognised
 					// player types, has a client player number greater
 					// than the number of players, or gives addresses for
-					// players local to the server (local/AI), it isn't
-					// valid game data.
+					// players local to the server (local/AI), or is a board
+					// size we can't represent, it isn't valid game data.
 					
 					if ((netbuf.at(0) != 's' && netbuf.at(0) != 'h')
 						|| (netbuf.at(1) != 2 && netbuf.at(1) != 4)
@@ -296,7 +300,9 @@ bool ClientStatusDialog::handleServerSock(Glib::IOCondition cond)
 						|| (netbuf.at(2) != 2 && netbuf.at(3) != 0)
 						|| (netbuf.at(4) != 2 && netbuf.at(5) != 0)
 						|| (netbuf.at(6) != 2 && netbuf.at(7) != 0)
-						|| (netbuf.at(8) != 2 && netbuf.at(9) != 0))
+						|| (netbuf.at(8) != 2 && netbuf.at(9) != 0)
+						|| !BoardGeometry::supported(netbuf.at(0) == 's',
+							netbuf.at(11), netbuf.at(12)))
 					{
 						errPop(_("Invalid data from server"));
 						response(Gtk::RESPONSE_CANCEL);
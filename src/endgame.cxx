@@ -0,0 +1,397 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "symmetry.hxx"
+#include "transposition.hxx"
+#include "endgame.hxx"
+#include "zobrist.hxx"
+
+//
+// Globals
+//
+
+// Bigger than any margin
+static const int infinity = 1 << 20;
+
+// Mixed into the hashes of positions whose results depend on how lines
+// reaching the horizon were scored
+static const uint64_t pessimistic_key = 0x9e3779b97f4a7c15ULL;
+static const uint64_t optimistic_key = 0xc2b2ae3d27d4eb4fULL;
+
+// Depth stored in the transposition table for results which didn't run into
+// the horizon anywhere, and so hold however far ahead we look
+static const int exact_depth = 255;
+
+//
+// Implementation
+//
+
+EndgameSolver::EndgameSolver()
+	: m_TT(ENDGAME_HASH_MB), m_pBoard(NULL), m_Me(pc_player_1), m_MeKey(0),
+		m_Optimistic(false), m_Stopped(false), m_Cancelled(false), m_Nodes(0),
+		m_Horizon(0), m_Cutoffs(0)
+{
+}
+
+void EndgameSolver::cancel()
+{
+	m_Cancelled = true;
+}
+
+void EndgameSolver::clear()
+{
+	m_TT.clear();
+}
+
+// Find the best move for the current player, and the final margin it leads to
+bool EndgameSolver::solve(const BoardState &b, const int ms, PackedMove &best, int &margin)
+{
+	BoardState board(b);
+	m_pBoard = &board;
+	m_Me = board.getPlayer();
+	m_MeKey = zobrist_searcher[m_Me - pc_player_1];
+	m_Nodes = 0;
+	m_Horizon = 0;
+	m_Cutoffs = 0;
+	m_Stopped = false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_Deadline = start + std::chrono::milliseconds(ms);
+
+	unsigned int n = orderedMoves(0);
+	std::vector<PackedMove> root(m_Moves.begin(), m_Moves.begin() + n);
+	best = root[0];
+	margin = 0;
+
+	// Lines which reach the horizon are scored as the worst possible result
+	// for us, then as the best.  The first gives a lower bound on what we
+	// can make sure of by finishing the game in time, the second an upper
+	// bound on what the opponents can hold us to; once they meet for our
+	// best move, and no other move could do better, the result is exact.
+	// Every empty square needs a move to fill it, unless players run out of
+	// moves first, so there's no point looking less far ahead than that.
+	const BoardGeometry &g = *board.getGeometry();
+	const int limit = g.squares + 1;
+	Bitboard empty;
+	board.getEmpty(empty);
+	bool exact = false;
+	for (int horizon = std::max(1, empty.count(g.words)); horizon < exact_depth;
+		++horizon)
+	{
+		m_Optimistic = false;
+		int alpha = -infinity;
+		int lower = -infinity;
+		unsigned int besti = 0;
+		unsigned int searched = 0;
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			int v = tryMove(root[i], horizon, alpha, infinity, n);
+			if (m_Stopped)
+				break;
+			++searched;
+			if (v > lower)
+			{
+				lower = v;
+				besti = i;
+				alpha = v;
+			}
+		}
+
+		if (searched > 0)
+		{
+			best = root[besti];
+			margin = lower;
+			std::rotate(root.begin(), root.begin() + besti, root.begin() + besti + 1);
+		}
+		if (m_Stopped)
+			break;
+
+		// Narrow windows will do for the upper bounds: all we need to know
+		// is whether any move could beat the best one's lower bound
+		m_Optimistic = true;
+		int upper = tryMove(root[0], horizon, lower - 1, limit + 1, n);
+		bool proven = (upper == lower);
+		for (unsigned int i = 1; proven && (i < n); ++i)
+		{
+			if (tryMove(root[i], horizon, lower, lower + 1, n) > lower)
+				proven = false;
+		}
+		if (m_Stopped)
+			break;
+		m_Horizon = horizon;
+
+		// Done once the result is certain, or if there isn't enough time
+		// left for the next iteration to have a chance of finishing
+		if (proven)
+		{
+			exact = true;
+			break;
+		}
+		if ((std::chrono::steady_clock::now() - start) * 2
+			> std::chrono::milliseconds(ms))
+		{
+			break;
+		}
+	}
+
+	m_pBoard = NULL;
+	return exact;
+}
+
+// Margin for the current position from the point of view of the side to move
+int EndgameSolver::negamax(const int plies, int alpha, int beta, const size_t base)
+{
+	++m_Nodes;
+	if (outOfTime())
+		return 0;
+
+	BoardState &b = *m_pBoard;
+	const BoardGeometry &g = *b.getGeometry();
+	const int alpha_orig = alpha;
+
+	// See if we've been here before, at least as far from the horizon.
+	// Results which never reached the horizon hold either way, but bounds
+	// from either side of the horizon are kept apart.  Reflections and
+	// rotations of the position share entries.
+	int symmetry;
+	uint64_t key = b.getCanonicalHash(symmetry) ^ m_MeKey;
+	uint64_t bounded_key = key ^ (m_Optimistic ? optimistic_key : pessimistic_key);
+	PackedMove hashed = PackedMove::none();
+	TTEntry e;
+	if (m_TT.probe(key, e) || m_TT.probe(bounded_key, e))
+	{
+		if ((e.depth == exact_depth) || (e.depth >= plies))
+		{
+			if ((e.bound == tb_exact)
+				|| ((e.bound == tb_lower) && (e.score >= beta))
+				|| ((e.bound == tb_upper) && (e.score <= alpha)))
+			{
+				if (e.depth != exact_depth)
+					++m_Cutoffs;
+				return e.score;
+			}
+		}
+		hashed = fromCanonical(g, symmetry, e.best);
+	}
+
+	// Out of moves before the end of the game: assume the worst, or the
+	// best, depending on which bound we're after
+	if (plies == 0)
+	{
+		++m_Cutoffs;
+		int v = b.getGeometry()->squares + 1;
+		if (!m_Optimistic)
+			v = -v;
+		return (b.getPlayer() == m_Me) ? v : -v;
+	}
+
+	// Blocked players have had their turns skipped already, so there's
+	// always something to do
+	unsigned int n = orderedMoves(base, hashed);
+	const unsigned long cutoffs = m_Cutoffs;
+	int best = -infinity;
+	unsigned int besti = 0;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		// Deeper plies may grow the move stack, so take a copy
+		PackedMove m(m_Moves[base + i]);
+		int v = tryMove(m, plies, alpha, beta, base + n);
+		if (m_Stopped)
+			return 0;
+		if (v > best)
+		{
+			best = v;
+			besti = i;
+			if (v > alpha)
+			{
+				alpha = v;
+				if (alpha >= beta)
+					break;
+			}
+		}
+	}
+
+	ttbound bound = tb_exact;
+	if (best <= alpha_orig)
+		bound = tb_upper;
+	else if (best >= beta)
+		bound = tb_lower;
+	PackedMove m = toCanonical(g, symmetry, m_Moves[base + besti]);
+	if (m_Cutoffs == cutoffs)
+		m_TT.store(key, best, exact_depth, bound, m);
+	else
+		m_TT.store(bounded_key, best, plies, bound, m);
+	return best;
+}
+
+// Make a move and find out the margin for the resulting position from the
+// point of view of the player who made it
+int EndgameSolver::tryMove(const PackedMove m, const int plies, const int alpha,
+	const int beta, const size_t base)
+{
+	BoardState &b = *m_pBoard;
+	piece side = b.getPlayer();
+	MoveUndo u = b.makeMove(m);
+
+	int v;
+	if (!b.skipBlockedPlayers(side))
+	{
+		// Nobody else can move, so the game is over
+		int scores[4];
+		b.getFilledScores(side, scores[0], scores[1], scores[2], scores[3]);
+		v = margin(scores);
+		if (side != m_Me)
+			v = -v;
+	}
+	else if ((b.getPlayer() == m_Me) == (side == m_Me))
+		// Still the same side's turn (opponents in a paranoid search)
+		v = negamax(plies - 1, alpha, beta, base);
+	else
+		v = -negamax(plies - 1, -beta, -alpha, base);
+
+	b.unmakeMove(u);
+	return v;
+}
+
+// Generate moves for the current player into the move stack at "base",
+// destination by destination, and sort them
+unsigned int EndgameSolver::orderedMoves(const size_t base, const PackedMove first)
+{
+	BoardState &b = *m_pBoard;
+	const BoardGeometry &g = *b.getGeometry();
+	size_t needed = base + b.getMaxMoves();
+	if (m_Moves.size() < needed)
+	{
+		m_Moves.resize(needed);
+		m_Keys.resize(needed);
+	}
+
+	PackedMove *moves = &m_Moves[base];
+	int *keys = &m_Keys[base];
+	unsigned int n = 0;
+	const Bitboard &mine = b.getPieces(b.getPlayer());
+	Bitboard empty;
+	b.getEmpty(empty);
+	Bitboard targets(empty);
+	for (int t = targets.pop(g.words); t != -1; t = targets.pop(g.words))
+	{
+		// Whatever moves into this square captures the same pieces.  Clones
+		// from different pieces have the same result, so make just one.
+		int captures = 0;
+		bool clone = false;
+		const uint16_t *end = g.endRing(t, 1);
+		for (const uint16_t *s = g.beginRing(t, 1); s != end; ++s)
+		{
+			if (mine.test(*s))
+				clone = true;
+			else if (!empty.test(*s))
+				++captures;
+		}
+		if (clone)
+		{
+			moves[n] = PackedMove(t);
+			keys[n++] = (captures * 2) + 1;
+		}
+
+		// Every jump into the square.  Directions are walked backwards so
+		// that the sources come in ascending order (see BoardGeometry::ring).
+		for (int r = g.ringsize[1] - 1; r >= 0; --r)
+		{
+			const int s = g.jumpSource(t, r);
+			if ((s >= 0) && (s < g.bits) && mine.test(s))
+			{
+				moves[n] = PackedMove(t, r);
+				keys[n++] = captures * 2;
+			}
+		}
+	}
+
+	// Best move from the last time we saw this position goes first
+	if (first != PackedMove::none())
+	{
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			if (moves[i] == first)
+			{
+				keys[i] = infinity;
+				break;
+			}
+		}
+	}
+
+	// Insertion sort, highest key first
+	for (unsigned int i = 1; i < n; ++i)
+	{
+		PackedMove m(moves[i]);
+		int k = keys[i];
+		unsigned int j = i;
+		for (; (j > 0) && (keys[j - 1] < k); --j)
+		{
+			moves[j] = moves[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		moves[j] = m;
+		keys[j] = k;
+	}
+	return n;
+}
+
+// Our score minus our best opponent's
+int EndgameSolver::margin(const int scores[4]) const
+{
+	int other = -1;
+	for (int i = 0; i < 4; ++i)
+	{
+		if ((i != m_Me - pc_player_1) && (scores[i] > other))
+			other = scores[i];
+	}
+	return scores[m_Me - pc_player_1] - other;
+}
+
+// Check the clock every so often, and note if we've run out of time or
+// been cancelled
+bool EndgameSolver::outOfTime()
+{
+	if (!m_Stopped && (m_Cancelled.load(std::memory_order_relaxed)
+		|| (((m_Nodes & 63) == 0)
+			&& (std::chrono::steady_clock::now() >= m_Deadline))))
+	{
+		m_Stopped = true;
+	}
+	return m_Stopped;
+}
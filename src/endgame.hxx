@@ -0,0 +1,123 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_ENDGAME_HXX
+#define INFECTOR_ENDGAME_HXX
+
+class BoardState;
+
+// Memory for the endgame solver's own transposition table, in megabytes
+#define ENDGAME_HASH_MB 16
+
+// Exact endgame search: with few empty squares left, play every line out to
+// the end of the game and score it by the final margin between us and our
+// best opponent, with empty squares filled as the rules say.  Nothing is
+// guessed by a heuristic, so the move found is provably the best one.
+//
+// Jumps don't fill squares, so some lines could go on for ever.  Lines are
+// searched up to a horizon, which grows until it's far enough away that
+// neither side can gain anything by dragging the game out past it (the
+// result is then exact), or until time runs out.
+//
+// Games with more than two players are searched "paranoid" style, as in
+// Search.  Results are kept in a transposition table of the solver's own,
+// so they don't push out the main search's entries; entries for lines that
+// ran into the horizon are marked as such, and never taken for exact ones.
+class EndgameSolver
+{
+	public:
+		EndgameSolver();
+
+		// Find the best move for the current player, spending at most "ms"
+		// milliseconds.  Returns true if "best" and "margin" (our final
+		// score minus our best opponent's) are exact, or false if time ran
+		// out first, in which case "best" is the move with the best
+		// guaranteed result found so far and "margin" is that guarantee.
+		// The current player must be able to move.
+		bool solve(const BoardState &b, const int ms, PackedMove &best, int &margin);
+
+		// Abandon the search in progress as soon as possible, and make any
+		// future searches return straight away.  Safe to call from any thread.
+		void cancel();
+
+		// Forget the results of earlier searches
+		void clear();
+
+		// Statistics about the most recent search: nodes visited, and the
+		// horizon of the deepest completed iteration, in plies
+		unsigned long getNodes() const
+		{
+			return m_Nodes;
+		};
+		int getHorizon() const
+		{
+			return m_Horizon;
+		};
+
+	private:
+		TranspositionTable m_TT;
+
+		// State of the search in progress: the board moves are made on, the
+		// player we're solving for, and a stack of generated moves with
+		// their ordering keys (each ply uses the space after its parent's)
+		BoardState *m_pBoard;
+		piece m_Me;
+		uint64_t m_MeKey;
+		std::vector<PackedMove> m_Moves;
+		std::vector<int> m_Keys;
+
+		// Whether lines reaching the horizon count as the best possible
+		// result for us, rather than the worst
+		bool m_Optimistic;
+
+		std::chrono::steady_clock::time_point m_Deadline;
+		bool m_Stopped;
+		std::atomic<bool> m_Cancelled;
+		unsigned long m_Nodes;
+		int m_Horizon;
+
+		// Number of times a line has been cut off by the horizon, so far in
+		// the current iteration.  A subtree is exact if it doesn't change.
+		unsigned long m_Cutoffs;
+
+		// Margin for the current position from the point of view of the
+		// side to move, searching up to "plies" moves ahead.  Moves for this
+		// ply are stored in the move stack starting from "base".
+		int negamax(const int plies, int alpha, int beta, const size_t base);
+
+		// Make a move and find out the margin for the resulting position
+		// from the point of view of the player who made it
+		int tryMove(const PackedMove m, const int plies, const int alpha, const int beta,
+			const size_t base);
+
+		// Generate moves for the current player into the move stack at
+		// "base", working through the empty squares: every clone into each
+		// square, then every jump.  Moves capturing the most pieces come
+		// first, clones before jumps, and the given move, if any, before
+		// everything.
+		unsigned int orderedMoves(const size_t base,
+			const PackedMove first = PackedMove::none());
+
+		// Our score minus our best opponent's, from the given scores
+		int margin(const int scores[4]) const;
+
+		// Check the clock every so often, and note if we've run out of time
+		// or been cancelled
+		bool outOfTime();
+};
+
+#endif
@@ -0,0 +1,539 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardkernel.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+
+//
+// Globals
+//
+
+// Feature counting is compiled three times on systems which can choose
+// between versions of a function when the program is loaded: for CPUs with
+// AVX2, where the loops over bitboard words are vectorised, for those with
+// POPCNT, where popcounts are single instructions, and for any x86-64 CPU.
+// The version is picked by the instructions the CPU has, not its model.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(MINGW)
+#define EVAL_KERNEL __attribute__((target_clones("avx2", "popcnt", "default")))
+#else
+#define EVAL_KERNEL
+#endif
+
+static const char *feature_names[EVAL_FEATURES] = {
+	"material", "defended", "attacking", "threatened", "exposure", "mobility"
+};
+
+//
+// Implementation
+//
+
+// Weights the AI has always used: 5 points for each square we own, 2 for
+// each of our pieces defending another, 1 for each enemy piece we're in a
+// position to attack, minus 4 for each of our pieces under threat and 1 for
+// every ten moves we'd lose
+EvalWeights::EvalWeights()
+	: rival(false)
+{
+	weights[ef_material] = 50;
+	weights[ef_defended] = 20;
+	weights[ef_attacking] = 10;
+	weights[ef_threatened] = -40;
+	weights[ef_exposure] = -10;
+	weights[ef_mobility] = 0;
+}
+
+bool EvalWeights::load(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+		return false;
+	int w[EVAL_FEATURES];
+	memcpy(w, weights, sizeof(w));
+	bool r = rival;
+	bool ok = true;
+	char line[256];
+	while (ok && fgets(line, sizeof(line), f))
+	{
+		char *hash = strchr(line, '#');
+		if (hash)
+			*hash = '\0';
+		char name[64];
+		int value;
+		int fields = sscanf(line, "%63s %d", name, &value);
+		if (fields <= 0)
+			continue;
+		ok = false;
+		if ((fields == 2) && (strcmp(name, "rival") == 0))
+		{
+			r = (value != 0);
+			ok = true;
+		}
+		for (int i = 0; (fields == 2) && (i < EVAL_FEATURES); ++i)
+		{
+			if (strcmp(name, feature_names[i]) == 0)
+			{
+				w[i] = value;
+				ok = true;
+			}
+		}
+	}
+	fclose(f);
+	if (ok)
+	{
+		memcpy(weights, w, sizeof(w));
+		rival = r;
+	}
+	return ok;
+}
+
+bool EvalWeights::save(const char *filename) const
+{
+	FILE *f = fopen(filename, "w");
+	if (!f)
+		return false;
+	fprintf(f, "# Infector evaluation weights, in 1/%d points\n", EVAL_SCALE);
+	for (int i = 0; i < EVAL_FEATURES; ++i)
+		fprintf(f, "%s %d\n", feature_names[i], weights[i]);
+	fprintf(f, "rival %d\n", rival ? 1 : 0);
+	return (fclose(f) == 0);
+}
+
+const char *EvalWeights::getName(const int feature)
+{
+	return feature_names[feature];
+}
+
+void Evaluator::setWeights(const EvalWeights &w)
+{
+	m_Weights = w;
+}
+
+// Score the board from the given player's point of view
+int Evaluator::evaluate(const BoardState &b, const piece me) const
+{
+	const BoardGeometry &g = *b.getGeometry();
+	Bitboard empty;
+	b.getEmpty(empty);
+	int score = standing(g, b.getPieces(me), empty, 0, g.words);
+	if (m_Weights.rival)
+	{
+		int counts[4];
+		b.getScores(counts[0], counts[1], counts[2], counts[3]);
+		score -= standing(g, b.getPieces((piece)(pc_player_1 + rival(counts, me))),
+			empty, 0, g.words);
+	}
+	return score / EVAL_SCALE;
+}
+
+// Score the position after each of the given moves, from the given
+// player's point of view.  Each move is made on a copy of the bitboards
+// and taken back again afterwards, without touching the board itself.
+//
+// A square's contribution to the features only depends on squares up to
+// three rows away, and a move only changes squares up to two rows from
+// its destination (the source of a jump, or captures next to it).  On
+// boards big enough for that to be less than the whole board, the standing
+// before the move is worked out once, and for each move only the band of
+// rows around its destination is counted again, before and after.
+void Evaluator::evaluateMoves(const BoardState &b, const piece me, const PackedMove *moves,
+	const unsigned int n, int *scores) const
+{
+	const BoardGeometry &g = *b.getGeometry();
+	const int mover = b.getPlayer() - pc_player_1;
+	const int us = me - pc_player_1;
+	Bitboard pieces[4], empty;
+	int counts[4];
+	for (int p = 0; p < 4; ++p)
+		pieces[p] = b.getPieces((piece)(pc_player_1 + p));
+	b.getEmpty(empty);
+	b.getScores(counts[0], counts[1], counts[2], counts[3]);
+
+	// Standings before the move over the whole board, and over the band
+	// around each row, for each player, worked out when first needed
+	int whole[4];
+	unsigned int known = 0;
+	std::vector<int> band(g.h * 4);
+	std::vector<unsigned char> banded(g.h, 0);
+
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		const int dest = moves[i].dest();
+		const bool jump = !moves[i].isClone();
+		const int source = jump ? g.jumpSource(dest, moves[i].direction()) : dest;
+
+		// Find the enemy pieces the move captures, and from that, who our
+		// main rival (if we're scoring against one) will be afterwards
+		int captured[8], owners[8], c = 0;
+		const uint16_t *end = g.endRing(dest, 1);
+		for (const uint16_t *j = g.beginRing(dest, 1); j != end; ++j)
+		{
+			if (empty.test(*j) || pieces[mover].test(*j))
+				continue;
+			int owner = 0;
+			while (!pieces[owner].test(*j))
+				++owner;
+			captured[c] = *j;
+			owners[c++] = owner;
+		}
+		int after[4] = { counts[0], counts[1], counts[2], counts[3] };
+		after[mover] += c + (jump ? 0 : 1);
+		for (int k = 0; k < c; ++k)
+			--after[owners[k]];
+		const int players[2] = { us, rival(after, me) };
+		const int scored = m_Weights.rival ? 2 : 1;
+
+		// Words covering the rows whose features the move can change
+		const int y = g.yOf(dest);
+		const int first = (std::max(y - 5, 0) * g.stride) >> 6;
+		const int last = std::min(((std::min(y + 5, g.h - 1) + 1) * g.stride + 63) >> 6,
+			g.words);
+		int outside[2] = { 0, 0 };
+		if ((first > 0) || (last < g.words))
+		{
+			for (int k = 0; k < scored; ++k)
+			{
+				const int p = players[k];
+				if (!(known & (1 << p)))
+				{
+					whole[p] = standing(g, pieces[p], empty, 0, g.words);
+					known |= 1 << p;
+				}
+				if (!(banded[y] & (1 << p)))
+				{
+					band[(y * 4) + p] = standing(g, pieces[p], empty, first, last);
+					banded[y] |= 1 << p;
+				}
+				outside[k] = whole[p] - band[(y * 4) + p];
+			}
+		}
+
+		for (int k = 0; k < c; ++k)
+		{
+			pieces[owners[k]].reset(captured[k]);
+			pieces[mover].set(captured[k]);
+		}
+		pieces[mover].set(dest);
+		empty.reset(dest);
+		if (jump)
+		{
+			pieces[mover].reset(source);
+			empty.set(source);
+		}
+
+		int score = outside[0] + standing(g, pieces[players[0]], empty, first, last);
+		if (m_Weights.rival)
+			score -= outside[1] + standing(g, pieces[players[1]], empty, first, last);
+		scores[i] = score / EVAL_SCALE;
+
+		if (jump)
+		{
+			pieces[mover].set(source);
+			empty.reset(source);
+		}
+		pieces[mover].reset(dest);
+		empty.set(dest);
+		for (int k = 0; k < c; ++k)
+		{
+			pieces[mover].reset(captured[k]);
+			pieces[owners[k]].set(captured[k]);
+		}
+	}
+}
+
+// Weighted sum of the features of the player whose pieces are "mine",
+// counted over the squares in words "first" to "last" (exclusive)
+int Evaluator::standing(const BoardGeometry &g, const Bitboard &mine,
+	const Bitboard &empty, const int first, const int last) const
+{
+	Bitboard enemy;
+	for (int i = 0; i < g.words; ++i)
+		enemy.words[i] = g.valid.words[i] & ~(empty.words[i] | mine.words[i]);
+	int features[EVAL_FEATURES];
+	countFeatures(g, mine, enemy, empty, first, last, features);
+	int score = 0;
+	for (int i = 0; i < EVAL_FEATURES; ++i)
+		score += features[i] * m_Weights.weights[i];
+	return score;
+}
+
+// Opponent of "me" with the most pieces, as an index into "counts".
+// Players who aren't in the game have a count of -1, so are never picked.
+int Evaluator::rival(const int counts[4], const piece me)
+{
+	int best = -1;
+	for (int i = 0; i < 4; ++i)
+	{
+		if ((i != me - pc_player_1) && ((best == -1) || (counts[i] > counts[best])))
+			best = i;
+	}
+	return best;
+}
+
+// Count up each feature of the board from the given player's point of view
+void Evaluator::getFeatures(const BoardState &b, const piece me,
+	int features[EVAL_FEATURES]) const
+{
+	const BoardGeometry &g = *b.getGeometry();
+	const Bitboard &mine = b.getPieces(me);
+	Bitboard empty, enemy;
+	b.getEmpty(empty);
+	for (int i = 0; i < g.words; ++i)
+		enemy.words[i] = g.valid.words[i] & ~(empty.words[i] | mine.words[i]);
+	countFeatures(g, mine, enemy, empty, 0, g.words, features);
+}
+
+// Word "w" of a set of squares moved by "k" squares (see
+// Bitboard::orShifted).  The set must have at least two words of zeros
+// either side of it, which covers the furthest any square can move.  Bits
+// from the neighbouring word are shifted in two steps, so that nothing is
+// shifted by 64 when "k" is a whole number of words.
+static inline uint64_t shifted(const uint64_t *p, const int w, const int k)
+{
+	if (k >= 0)
+	{
+		const int q = k >> 6, r = k & 63;
+		return (p[w - q] << r) | ((p[w - q - 1] >> 1) >> (63 - r));
+	}
+	const int q = (-k) >> 6, r = (-k) & 63;
+	return (p[w + q] >> r) | ((p[w + q + 1] << 1) << (63 - r));
+}
+
+// Add one to a count kept for every square in a word, for the squares in
+// "x".  The counts are "bit sliced": bit i of each count is in planes[i].
+template <int N> static inline void accumulate(uint64_t (&planes)[N], uint64_t x)
+{
+	for (int p = 0; p < N; ++p)
+	{
+		uint64_t carry = planes[p] & x;
+		planes[p] ^= x;
+		x = carry;
+	}
+}
+
+// Count every feature at once, for the squares in words "first" to "last".
+// The square-by-square rules (see evalfeature) come down to shifting sets
+// of squares by the offsets to their neighbours, and counting where they
+// overlap.  Shifts are done a word at a time, so that everything for a
+// word stays in registers.
+template <class Board> static KERNEL_INLINE void countFeaturesOn(const BoardGeometry &g,
+	const Bitboard &mine, const Bitboard &enemy, const Bitboard &empty,
+	const int first, const int last, int features[EVAL_FEATURES])
+{
+	const int n = Board::words(g);
+	const int ring0 = Board::ringsize(g, 0), ring1 = Board::ringsize(g, 1);
+	const int corners = Board::cornersize(g);
+	uint64_t padded[4][BITBOARD_WORDS + 4];
+	for (int i = 0; i < 4; ++i)
+	{
+		padded[i][0] = padded[i][1] = 0;
+		padded[i][n + 2] = padded[i][n + 3] = 0;
+	}
+	uint64_t *m = padded[0] + 2, *e = padded[1] + 2, *x = padded[2] + 2;
+	uint64_t *threats = padded[3] + 2;
+	KERNEL_UNROLL
+	for (int w = 0; w < n; ++w)
+	{
+		m[w] = mine.words[w];
+		e[w] = enemy.words[w];
+		x[w] = empty.words[w];
+	}
+
+	// Threatened squares are needed up to two words either side of the
+	// squares being counted, for the pieces next to them
+	int defended = 0, attacking = 0, mobility = 0;
+	for (int w = std::max(first - 2, 0); w < std::min(last + 2, n); ++w)
+	{
+		// Our pieces next to each other, and squares next to our pieces
+		// and next to enemies
+		uint64_t near_mine = 0, near_enemy = 0;
+		int neighbours = 0;
+		KERNEL_UNROLL
+		for (int r = 0; r < ring0; ++r)
+		{
+			uint64_t s = shifted(m, w, Board::ring(g, 0, r));
+			neighbours += __builtin_popcountll(m[w] & s);
+			near_mine |= s;
+			near_enemy |= shifted(e, w, Board::ring(g, 0, r));
+		}
+
+		// On hexagonal boards, two of the eight squares surrounding each
+		// square are actually at jump distance.  Enemy pieces there can
+		// still threaten the square, and ours can attack enemies there.
+		uint64_t corner_mine = 0;
+		KERNEL_UNROLL
+		for (int c = 0; c < corners; ++c)
+		{
+			corner_mine |= shifted(m, w, Board::corner(g, c));
+			near_enemy |= shifted(e, w, Board::corner(g, c));
+		}
+
+		uint64_t far_mine = 0;
+		KERNEL_UNROLL
+		for (int r = 0; r < ring1; ++r)
+			far_mine |= shifted(m, w, Board::ring(g, 1, r));
+
+		if ((w >= first) && (w < last))
+		{
+			defended += neighbours;
+			attacking += __builtin_popcountll(e[w] & corner_mine);
+			mobility += __builtin_popcountll(x[w] & (near_mine | far_mine));
+		}
+
+		// Empty squares next to our pieces which an enemy could move
+		// into, capturing them
+		threats[w] = x[w] & near_mine & near_enemy;
+	}
+
+	// Our pieces next to threatened squares, counted once for each of them
+	int threatened = 0, material = 0;
+	bool exposed = false;
+	for (int w = first; w < last; ++w)
+	{
+		material += __builtin_popcountll(m[w]);
+		exposed |= (threats[w] != 0);
+		if (!m[w])
+			continue;
+		uint64_t around[4] = { 0, 0, 0, 0 };
+		KERNEL_UNROLL
+		for (int r = 0; r < ring0; ++r)
+			accumulate(around, shifted(threats, w, Board::ring(g, 0, r)));
+		KERNEL_UNROLL
+		for (int j = 0; j < 4; ++j)
+			threatened += __builtin_popcountll(m[w] & around[j]) << j;
+	}
+
+	// Moves we'd lose to an enemy moving into each threatened square: the
+	// reach (empty squares within jump distance) of each of our pieces next
+	// to it, plus our pieces which could otherwise jump into it.  They're
+	// counted in tens, rounded down for each square, so that the default
+	// weight takes a point off for every ten moves as it always has.
+	int lost = 0;
+	if (exposed)
+	{
+		// Reach of each of our pieces, up to two words either side of the
+		// squares being counted
+		uint64_t padded_reach[5][BITBOARD_WORDS + 4];
+		uint64_t *reach[5];
+		for (int i = 0; i < 5; ++i)
+		{
+			reach[i] = padded_reach[i] + 2;
+			reach[i][-2] = reach[i][-1] = 0;
+			reach[i][n] = reach[i][n + 1] = 0;
+		}
+		for (int w = std::max(first - 2, 0); w < std::min(last + 2, n); ++w)
+		{
+			uint64_t counts[5] = { 0, 0, 0, 0, 0 };
+			if (m[w])
+			{
+				KERNEL_UNROLL
+				for (int r = 0; r < ring0; ++r)
+					accumulate(counts, shifted(x, w, Board::ring(g, 0, r)));
+				KERNEL_UNROLL
+				for (int r = 0; r < ring1; ++r)
+					accumulate(counts, shifted(x, w, Board::ring(g, 1, r)));
+			}
+			for (int i = 0; i < 5; ++i)
+				reach[i][w] = counts[i] & m[w];
+		}
+
+		for (int w = first; w < last; ++w)
+		{
+			if (!threats[w])
+				continue;
+
+			// Add up the moves for every square in the word at once, in
+			// bit sliced counts, then take the threatened squares' apart
+			uint64_t total[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+			KERNEL_UNROLL
+			for (int r = 0; r < ring0; ++r)
+			{
+				uint64_t carry = 0;
+				for (int i = 0; i < 8; ++i)
+				{
+					const uint64_t add = (i < 5) ? shifted(reach[i], w, Board::ring(g, 0, r)) : 0;
+					const uint64_t sum = total[i] ^ add;
+					const uint64_t next = (total[i] & add) | (carry & sum);
+					total[i] = sum ^ carry;
+					carry = next;
+				}
+			}
+			KERNEL_UNROLL
+			for (int r = 0; r < ring1; ++r)
+				accumulate(total, shifted(m, w, Board::ring(g, 1, r)));
+			for (uint64_t t = threats[w]; t; t &= t - 1)
+			{
+				const int bit = __builtin_ctzll(t);
+				int moves = 0;
+				for (int i = 0; i < 8; ++i)
+					moves |= (int)((total[i] >> bit) & 1) << i;
+				lost += moves / 10;
+			}
+		}
+	}
+
+	features[ef_material] = material;
+	features[ef_defended] = defended;
+	features[ef_attacking] = attacking;
+	features[ef_threatened] = threatened;
+	features[ef_exposure] = lost;
+	features[ef_mobility] = mobility;
+}
+
+EVAL_KERNEL
+void Evaluator::countFeatures(const BoardGeometry &g, const Bitboard &mine,
+	const Bitboard &enemy, const Bitboard &empty, const int first, const int last,
+	int features[EVAL_FEATURES])
+{
+	switch (g.kernel)
+	{
+		case bk_square_7:
+			countFeaturesOn<FixedBoard<true, 7> >(g, mine, enemy, empty, first, last,
+				features);
+			break;
+		case bk_square_8:
+			countFeaturesOn<FixedBoard<true, 8> >(g, mine, enemy, empty, first, last,
+				features);
+			break;
+		case bk_hex_5:
+			countFeaturesOn<FixedBoard<false, 5> >(g, mine, enemy, empty, first, last,
+				features);
+			break;
+		default:
+			countFeaturesOn<AnyBoard>(g, mine, enemy, empty, first, last, features);
+	}
+}
@@ -0,0 +1,127 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_EVALUATOR_HXX
+#define INFECTOR_EVALUATOR_HXX
+
+class BoardState;
+struct PackedMove;
+struct BoardGeometry;
+
+// Things about a position the evaluation takes into account, counted from
+// one player's point of view
+enum evalfeature
+{
+	ef_material,	// pieces we own
+	ef_defended,	// our pieces next to each of our pieces
+	ef_attacking,	// enemy pieces touching one of ours at the corner
+					// (hexagonal boards only)
+	ef_threatened,	// our pieces next to empty squares an enemy could
+					// move into
+	ef_exposure,	// moves we'd lose if an enemy did so, in tens,
+					// rounded down for each square
+	ef_mobility,	// empty squares we can move into
+	EVAL_FEATURES
+};
+
+// Weights are in fractions of a point, so they can be finer than the scores
+#define EVAL_SCALE 10
+
+// How much each feature counts for in the evaluation.  The defaults are the
+// weights the AI has always used; others can be loaded from a text file,
+// with one "name value" pair on each line (see getName()) and anything
+// after a '#' ignored.  Features a file doesn't mention keep their defaults.
+//
+// "rival 1" in a file scores positions relative to our main rival (see
+// Evaluator), as weights fitted by infector-tune expect.  It's off by
+// default, which scores our own standing alone, as the AI always has.
+struct EvalWeights
+{
+	int weights[EVAL_FEATURES];
+	bool rival;
+
+	EvalWeights();
+
+	// Read weights from the given file.  Returns false, leaving the
+	// weights as they were, if it can't be read or has anything in it
+	// other than known features' weights.
+	bool load(const char *filename);
+
+	// Write the weights out in the form load() reads
+	bool save(const char *filename) const;
+
+	// Name for the given feature, as used in weights files
+	static const char *getName(const int feature);
+};
+
+// Heuristic scoring of board positions, used by the AI to judge moves.
+//
+// Each player's standing is the sum of each feature's count, from their
+// point of view, multiplied by its weight.  A position's score is our
+// standing, or with EvalWeights::rival set, our standing less that of our
+// main rival: the opponent with the most pieces.
+// Features are counted for the whole board at once, from bitboards, with
+// a few dozen shifts, ANDs and popcounts, so scoring a position from
+// scratch is cheap enough that there's nothing to keep up to date.
+class Evaluator
+{
+	public:
+		// Weights to score positions with, in place of the defaults
+		void setWeights(const EvalWeights &w);
+		const EvalWeights &getWeights() const
+		{
+			return m_Weights;
+		};
+
+		// Score the board from the given player's point of view.  Higher is
+		// better; only differences between scores for the same player mean
+		// anything.
+		int evaluate(const BoardState &b, const piece me) const;
+
+		// Score the position after each of "n" moves by the current player
+		// from the given player's point of view, into "scores", without
+		// making them.  The scores are the same as evaluate() would give,
+		// but the board is only set up once for all of the moves.
+		void evaluateMoves(const BoardState &b, const piece me, const PackedMove *moves,
+			const unsigned int n, int *scores) const;
+
+		// Count up each feature of the board from the given player's point
+		// of view, before weighting
+		void getFeatures(const BoardState &b, const piece me,
+			int features[EVAL_FEATURES]) const;
+
+	private:
+		EvalWeights m_Weights;
+
+		// Weighted sum of the features of the player whose pieces are
+		// "mine", in fractions of a point (see EVAL_SCALE), counted over
+		// the squares in bitboard words "first" up to (not including) "last"
+		int standing(const BoardGeometry &g, const Bitboard &mine,
+			const Bitboard &empty, const int first, const int last) const;
+
+		// Opponent of "me" with the most pieces, given everyone's piece
+		// counts, as an index into them
+		static int rival(const int counts[4], const piece me);
+
+		// Count up the features for the player whose pieces are "mine",
+		// over the squares in words "first" up to (not including) "last"
+		static void countFeatures(const BoardGeometry &g, const Bitboard &mine,
+			const Bitboard &enemy, const Bitboard &empty, const int first,
+			const int last, int features[EVAL_FEATURES]);
+};
+
+#endif
@@ -25,10 +25,13 @@
 #include "infector-i18n.hxx"
 
 // Language headers
+#include <cstdint>
+#include <vector>
 #include <cstdlib>
 #include <algorithm>
 #include <deque>
 #include <memory>
+#include <thread>
 
 // Library headers
 #include <gtkmm.h>
@@ -37,6 +40,8 @@
 
 // Project headers
 #include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "boardstate.hxx"
 #include "game.hxx"
 #include "gameboard.hxx"
@@ -372,29 +377,16 @@ void Game::onSquareClicked(const int x, const int y)
 			// If not, skip until we find someone who can.
 			// If we come full circle, the game has ended.
 			piece endplayer = m_BoardState.getPlayer();
-			piece nextplayer = m_BoardState.nextPlayer();
-			while (!m_BoardState.canMove(nextplayer))
+			m_BoardState.nextPlayer();
+			if (!m_BoardState.skipBlockedPlayers(endplayer))
 			{
-				nextplayer = m_BoardState.nextPlayer();
-				if (nextplayer == endplayer)
-				{
-					m_gameover = true;
+				m_gameover = true;
 
-					// Make all remaining empty squares be owned by the
-					// winning player, to advance the board to the state
-					// it would be in if the game continued to be played
-					// to its logical conclusion.
-					for (int i = 0; i < m_GameType.w; ++i)
-					{
-						for (int j = 0; j < m_GameType.h; ++j)
-						{
-							if (m_BoardState.getPieceAt(i, j) == pc_player_none)
-								m_BoardState.setPieceAt(i, j, endplayer);
-						}
-					}
-
-					break;
-				}
+				// Make all remaining empty squares be owned by the
+				// winning player, to advance the board to the state
+				// it would be in if the game continued to be played
+				// to its logical conclusion.
+				m_BoardState.fillEmpty(endplayer);
 			}
 			
 			// TODO - Change this to pass in a move structure.
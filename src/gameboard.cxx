@@ -24,8 +24,11 @@
 #include <config.h>
 
 // Language headers
+#include <cstdint>
+#include <vector>
 #include <cstdlib>
 #include <memory>
+#include <thread>
 
 // Library headers
 #include <gtkmm.h>
@@ -34,6 +37,8 @@
 
 // Project headers
 #include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "boardstate.hxx"
 #include "game.hxx"
 #include "gameboard.hxx"
@@ -46,7 +51,8 @@
 // Constructor
 GameBoard::GameBoard(BaseObjectType *cobject, const Glib::RefPtr<Gtk::Builder> &refXml)
 	: Gtk::DrawingArea(cobject), m_DefaultGameType(), m_DefaultBoardState(&m_DefaultGameType),
-		m_pBoardState(NULL), m_pGameType(NULL), bw(m_DefaultGameType.w), bh(m_DefaultGameType.h)
+		m_pBoardState(NULL), m_pGameType(NULL), bw(m_DefaultBoardState.getGeometry()->w),
+		bh(m_DefaultBoardState.getGeometry()->h)
 {
 	// Connect mouse click events to the onClick handler
 	signal_button_press_event().connect(sigc::mem_fun(*this, &GameBoard::onClick));
@@ -365,9 +371,11 @@ void GameBoard::newGame(Game *g, const BoardState *b, const GameType *gt)
 	m_pBoardState = b;
 	m_pGameType = gt;
 
-	// Store board width & height locally to keep code clean
-	bw = m_pGameType->w;
-	bh = m_pGameType->h;
+	// Store board width & height locally to keep code clean.  These are
+	// the board's own, which for hexagonal boards aren't the game type's
+	// edge lengths.
+	bw = m_pBoardState->getGeometry()->w;
+	bh = m_pBoardState->getGeometry()->h;
 
 	// Store board shape so that later on, when the game has ended,
 	// the board doesn't magically flip from hexagonal back to square
@@ -27,6 +27,13 @@ enum playertype
 	pt_none
 };
 
+// Enumerated type for the search used by AI players
+enum aiengine
+{
+	ae_alphabeta,
+	ae_montecarlo
+};
+
 // Enumerated type for board square states
 enum piece
 {
@@ -47,9 +54,14 @@ struct GameType
 	playertype player_2;
 	playertype player_3;
 	playertype player_4;
+	aiengine engine_1;
+	aiengine engine_2;
+	aiengine engine_3;
+	aiengine engine_4;
 	GameType()
 		: w(8), h(8), square(true), player_1(pt_none), player_2(pt_none),
-			player_3(pt_none), player_4(pt_none)
+			player_3(pt_none), player_4(pt_none), engine_1(ae_alphabeta),
+			engine_2(ae_alphabeta), engine_3(ae_alphabeta), engine_4(ae_alphabeta)
 	{};
 	bool anyPlayersOfType(const playertype pt) const
 	{
@@ -84,6 +96,29 @@ struct GameType
 				return player_4;
 		}
 	};
+	aiengine engineOf(const piece pc) const
+	{
+		switch (pc)
+		{
+			case pc_player_1:
+				return engine_1;
+			case pc_player_2:
+				return engine_2;
+			case pc_player_3:
+				return engine_3;
+			default:
+				return engine_4;
+		}
+	};
+	bool anyAIsUsing(const aiengine ae) const
+	{
+		for (int p = pc_player_1; p <= pc_player_4; ++p)
+		{
+			if ((typeOf((piece)p) == pt_ai) && (engineOf((piece)p) == ae))
+				return true;
+		}
+		return false;
+	};
 };
 
 #endif
@@ -25,7 +25,10 @@
 #include "infector-i18n.hxx"
 
 // Language headers
+#include <cstdint>
+#include <vector>
 #include <memory>
+#include <thread>
 #include <cstdlib>
 #include <sstream>
 #include <algorithm>
@@ -43,6 +46,8 @@
 // Project headers
 #include "gametype.hxx"
 #include "socket.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
 #include "boardstate.hxx"
 #include "game.hxx"
 #include "gameboard.hxx"
@@ -0,0 +1,436 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "playout.hxx"
+#include "montecarlo.hxx"
+
+//
+// Globals
+//
+
+// Node states: no children yet, children being added by some thread, and
+// children ready to be walked
+enum
+{
+	ns_leaf,
+	ns_expanding,
+	ns_expanded
+};
+
+// Result of a won game.  Players who tie for the win share it, so it's
+// divisible by every possible number of winners.
+static const uint32_t win_reward = 12;
+
+// Weight of the UCT bonus for moves which haven't been tried much
+static const double exploration = 0.7;
+
+// Nodes are given children once they've been visited this many times, so
+// that the tree isn't filled up with positions only played out once
+static const uint32_t expand_visits = 4;
+
+// How far below the old root to look for the new one: the longest run of
+// moves from one of our turns to the next, in a four player game
+static const int reuse_plies = 4;
+
+// Playouts stop after this many moves, and whoever has the most pieces at
+// that point is taken to have won.  Random moves soon stop saying much
+// about the position played out from, and playing to the end of the game
+// makes for fewer, noisier playouts: in self-play, stopping early wins
+// against alpha-beta search as often as it loses, playing to the end
+// hardly ever.
+static const int playout_moves = 8;
+
+// Playouts play clones before jumps, and clones which capture before those
+// which don't: it costs little to tell, and games between players who never
+// look at what they're doing say little about who's winning
+static const playoutpolicy policy = pp_captures;
+
+//
+// Implementation
+//
+
+// Each player's share of the win in a finished game
+static void share(const int scores[4], uint32_t rewards[4])
+{
+	int top = scores[0];
+	for (int p = 1; p < 4; ++p)
+		top = std::max(top, scores[p]);
+	uint32_t winners = 0;
+	for (int p = 0; p < 4; ++p)
+		winners += (scores[p] == top) ? 1 : 0;
+	for (int p = 0; p < 4; ++p)
+		rewards[p] = (scores[p] == top) ? (win_reward / winners) : 0;
+}
+
+MonteCarloSearch::MonteCarloSearch()
+	: m_TimeBudget(400), m_MaxPlayouts(0), m_Threads(1), m_Random(time(NULL)),
+		m_Capacity(0), m_Used(0), m_Stopped(false), m_Cancelled(false), m_Playouts(0),
+		m_Depth(0), m_Score(0)
+{
+	setThreads(std::thread::hardware_concurrency());
+	setTreeSize(MONTECARLO_TREE_MB);
+}
+
+MonteCarloSearch::~MonteCarloSearch()
+{
+}
+
+void MonteCarloSearch::setTimeBudget(const int ms)
+{
+	m_TimeBudget = ms;
+}
+
+void MonteCarloSearch::setMaxPlayouts(const unsigned long playouts)
+{
+	m_MaxPlayouts = playouts;
+}
+
+void MonteCarloSearch::setThreads(const unsigned int threads)
+{
+	// hardware_concurrency() returns 0 if it doesn't know
+	m_Threads = std::max(threads, 1U);
+}
+
+void MonteCarloSearch::setTreeSize(const size_t mb)
+{
+	// Always leave room for the root and all its children, and room to
+	// spare below 2^32 for threads which overrun the end of a full pool.
+	// The pool is allocated when it's first needed.
+	size_t nodes = (mb << 20) / sizeof(Node);
+	nodes = std::max(nodes, (size_t)MAX_MOVES + 1);
+	nodes = std::min(nodes, (size_t)UINT32_MAX / 2);
+	m_Capacity = nodes;
+	m_pNodes.reset();
+	clear();
+}
+
+void MonteCarloSearch::setSeed(const unsigned int seed)
+{
+	m_Random.seed(seed);
+}
+
+void MonteCarloSearch::cancel()
+{
+	m_Cancelled = true;
+	m_Stopped = true;
+}
+
+void MonteCarloSearch::clear()
+{
+	// The pool is kept, for the next tree
+	m_pRoot.reset();
+	m_Used = 0;
+}
+
+// Find the best move for the current player
+bool MonteCarloSearch::findMove(const BoardState &b, PackedMove &best)
+{
+	m_Playouts = 0;
+	m_Depth = 0;
+	m_Score = 0;
+	m_Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_TimeBudget);
+
+	std::vector<PackedMove> moves(b.getMaxMoves());
+	unsigned int n = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+	if (n == 0)
+		return false;
+	best = moves[0];
+	if (n == 1)
+		return true;
+
+	reroot(b);
+	Node &root = m_pNodes[0];
+	if (root.state.load(std::memory_order_relaxed) != ns_expanded)
+	{
+		expand(root, b, moves.data());
+		root.state.store(ns_expanded, std::memory_order_relaxed);
+	}
+
+	// Every thread gets its own random numbers
+	m_Stopped = m_Cancelled.load();
+	std::vector<std::thread> helpers;
+	for (unsigned int i = 1; i < m_Threads; ++i)
+		helpers.push_back(std::thread(&MonteCarloSearch::work, this, m_Random()));
+	work(m_Random());
+	for (size_t i = 0; i < helpers.size(); ++i)
+		helpers[i].join();
+
+	// Play the move we know most about, which is also the one UCT thought
+	// most of.  The tree is kept for next time.
+	const Node *children = &m_pNodes[root.children];
+	uint32_t most = 0;
+	for (unsigned int i = 0; i < root.count; ++i)
+	{
+		const uint32_t visits = children[i].visits.load(std::memory_order_relaxed);
+		if (visits > most)
+		{
+			most = visits;
+			best = children[i].move;
+			m_Score = (1000 * (uint64_t)children[i].reward.load(std::memory_order_relaxed))
+				/ (win_reward * (uint64_t)visits);
+		}
+	}
+	return true;
+}
+
+// Move the root to the given position, or start a new tree
+void MonteCarloSearch::reroot(const BoardState &b)
+{
+	uint32_t n = m_Capacity;
+	if (m_pRoot && (m_pRoot->getGeometry() == b.getGeometry()))
+		n = find(0, *m_pRoot, b, reuse_plies);
+	if ((n != m_Capacity) && (m_pNodes[n].state.load(std::memory_order_relaxed) != ns_expanded))
+		n = m_Capacity;
+	m_pRoot.reset(new BoardState(b));
+
+	if (n == m_Capacity)
+	{
+		if (!m_pNodes)
+			m_pNodes.reset(new Node[m_Capacity]);
+		Node &root = m_pNodes[0];
+		root.visits.store(0, std::memory_order_relaxed);
+		root.reward.store(0, std::memory_order_relaxed);
+		root.state.store(ns_leaf, std::memory_order_relaxed);
+		m_Used = 1;
+		return;
+	}
+	if (n == 0)
+		return;
+
+	// Gather up the subtree
+	std::vector<uint32_t> from(1, n);
+	for (size_t i = 0; i < from.size(); ++i)
+	{
+		const Node &f = m_pNodes[from[i]];
+		if (f.state.load(std::memory_order_relaxed) == ns_expanded)
+		{
+			for (unsigned int j = 0; j < f.count; ++j)
+				from.push_back(f.children + j);
+		}
+	}
+
+	// Move it down to the start of the pool, keeping the nodes in the
+	// order they were added in.  Children are always added after their
+	// parents, so the new root comes first, and each node moves down over
+	// ones which have already been moved (or aren't being kept), so the
+	// pool doesn't need copying.  Children stay together.
+	std::sort(from.begin(), from.end());
+	for (size_t i = 0; i < from.size(); ++i)
+	{
+		const Node &f = m_pNodes[from[i]];
+		const uint32_t visits = f.visits.load(std::memory_order_relaxed);
+		const uint32_t reward = f.reward.load(std::memory_order_relaxed);
+		const bool expanded = (f.state.load(std::memory_order_relaxed) == ns_expanded);
+		const uint32_t children = expanded
+			? std::lower_bound(from.begin(), from.end(), f.children) - from.begin() : 0;
+		const uint16_t count = expanded ? f.count : 0;
+		const PackedMove move = f.move;
+		const uint8_t player = f.player;
+
+		Node &t = m_pNodes[i];
+		t.visits.store(visits, std::memory_order_relaxed);
+		t.reward.store(reward, std::memory_order_relaxed);
+		t.move = move;
+		t.player = player;
+		t.children = children;
+		t.count = count;
+		t.state.store(expanded ? ns_expanded : ns_leaf, std::memory_order_relaxed);
+	}
+	m_Used = from.size();
+}
+
+// Find a position up to "plies" moves below node "n"
+uint32_t MonteCarloSearch::find(const uint32_t n, const BoardState &b,
+	const BoardState &target, const int plies) const
+{
+	if (b.getHash() == target.getHash())
+		return n;
+	const Node &node = m_pNodes[n];
+	if ((plies == 0) || (node.state.load(std::memory_order_relaxed) != ns_expanded))
+		return m_Capacity;
+
+	for (unsigned int i = 0; i < node.count; ++i)
+	{
+		// A square only becomes empty again when a piece jumps out of it,
+		// which is rare enough in a few moves that lines with squares moved
+		// into that are now empty needn't be looked at
+		const uint32_t c = node.children + i;
+		const int dest = m_pNodes[c].move.dest();
+		if (target.getPieceAt(dest) == pc_player_none)
+			continue;
+		BoardState next(b);
+		piece mover = next.getPlayer();
+		next.makeMove(m_pNodes[c].move);
+		if (!next.skipBlockedPlayers(mover))
+			continue;
+		uint32_t found = find(c, next, target, plies - 1);
+		if (found != m_Capacity)
+			return found;
+	}
+	return m_Capacity;
+}
+
+// Give a node a child for each move
+bool MonteCarloSearch::expand(Node &n, const BoardState &b, PackedMove *moves)
+{
+	unsigned int count = b.generateMoves(b.getPlayer(), moves, b.getMaxMoves());
+	uint32_t first = m_Used.fetch_add(count, std::memory_order_relaxed);
+	if ((first >= m_Capacity) || (count > m_Capacity - first))
+		return false;
+
+	const uint8_t player = b.getPlayer() - pc_player_1;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		Node &c = m_pNodes[first + i];
+		c.visits.store(0, std::memory_order_relaxed);
+		c.reward.store(0, std::memory_order_relaxed);
+		c.children = 0;
+		c.count = 0;
+		c.move = moves[i];
+		c.player = player;
+		c.state.store(ns_leaf, std::memory_order_relaxed);
+	}
+	n.children = first;
+	n.count = count;
+	return true;
+}
+
+// Body of each thread
+void MonteCarloSearch::work(const unsigned int seed)
+{
+	std::mt19937 random(seed);
+	std::vector<PackedMove> moves(m_pRoot->getMaxMoves());
+	std::vector<Node *> path;
+	int scores[4];
+	uint32_t rewards[4];
+	bool finished;
+
+	while (!m_Stopped.load(std::memory_order_relaxed))
+	{
+		if ((m_MaxPlayouts && (m_Playouts.load(std::memory_order_relaxed) >= m_MaxPlayouts))
+			|| (std::chrono::steady_clock::now() >= m_Deadline))
+		{
+			m_Stopped = true;
+			break;
+		}
+
+		// Walk down the tree, counting the visits as we go
+		BoardState b(*m_pRoot);
+		Node *n = &m_pNodes[0];
+		n->visits.fetch_add(1, std::memory_order_relaxed);
+		path.clear();
+		piece mover = pc_player_none;
+		bool over = false;
+		for (;;)
+		{
+			uint8_t state = n->state.load(std::memory_order_acquire);
+			if (state == ns_leaf)
+			{
+				// Give the node children once it's been visited enough,
+				// unless somebody else got there first
+				if ((n->visits.load(std::memory_order_relaxed) < expand_visits)
+					|| (m_Used.load(std::memory_order_relaxed) >= m_Capacity)
+					|| !n->state.compare_exchange_strong(state, ns_expanding,
+						std::memory_order_acquire))
+				{
+					break;
+				}
+				if (!expand(*n, b, moves.data()))
+				{
+					n->state.store(ns_leaf, std::memory_order_release);
+					break;
+				}
+				n->state.store(ns_expanded, std::memory_order_release);
+			}
+			else if (state != ns_expanded)
+				break;
+
+			// UCT: pick the child with the best win rate for the player
+			// choosing, plus a bonus for being visited less than the rest.
+			// Children nobody has visited yet come first.
+			Node *children = &m_pNodes[n->children];
+			Node *next = NULL;
+			const double logn = std::log((double)n->visits.load(std::memory_order_relaxed));
+			double best = -1;
+			for (unsigned int i = 0; i < n->count; ++i)
+			{
+				const uint32_t visits = children[i].visits.load(std::memory_order_relaxed);
+				if (visits == 0)
+				{
+					next = &children[i];
+					break;
+				}
+				const double value = (children[i].reward.load(std::memory_order_relaxed)
+					/ (double)(win_reward * visits)) + (exploration * std::sqrt(logn / visits));
+				if (value > best)
+				{
+					best = value;
+					next = &children[i];
+				}
+			}
+
+			next->visits.fetch_add(1, std::memory_order_relaxed);
+			path.push_back(next);
+			n = next;
+			mover = b.getPlayer();
+			b.makeMove(n->move);
+			if (!b.skipBlockedPlayers(mover))
+			{
+				over = true;
+				break;
+			}
+		}
+
+		int depth = m_Depth.load(std::memory_order_relaxed);
+		while ((depth < (int)path.size())
+			&& !m_Depth.compare_exchange_weak(depth, path.size(), std::memory_order_relaxed));
+
+		// Finish the game, and share out the result
+		if (over)
+			b.getFilledScores(mover, scores[0], scores[1], scores[2], scores[3]);
+		else
+			playout(b, random, policy, playout_moves, scores, finished);
+		share(scores, rewards);
+		for (size_t i = 0; i < path.size(); ++i)
+			path[i]->reward.fetch_add(rewards[path[i]->player], std::memory_order_relaxed);
+		m_Playouts.fetch_add(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,159 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_MONTECARLO_HXX
+#define INFECTOR_MONTECARLO_HXX
+
+class BoardState;
+
+// Default memory for the tree, in megabytes
+#define MONTECARLO_TREE_MB 64
+
+// Monte Carlo tree search, an alternative to Search.  Instead of scoring
+// positions with the evaluator, it plays games on for a few moves
+// ("playouts"), quickly and at random but for a preference for capturing,
+// and counts a win for whoever is ahead at the end.  It grows a tree of the
+// lines which do best.  Each player picks moves by UCT: the move with the
+// best win rate so far, plus a bonus for having been tried less often than
+// its siblings.  Everybody plays to win for themselves, so
+// games with more than two players needn't be searched "paranoid" style.
+//
+// Several threads can grow the same tree at once.  Threads count a visit
+// to each node on their way down the tree, but only add in the result on
+// their way back up, so until then the line looks like it lost ("virtual
+// loss"), and other threads are steered onto different lines.
+//
+// The tree is kept from one search to the next.  If the position searched
+// is in the tree already (usually after our last move and the replies to
+// it), the search carries on from there instead of starting afresh.
+class MonteCarloSearch
+{
+	public:
+		MonteCarloSearch();
+		~MonteCarloSearch();
+
+		// Limits for each search: thinking time in milliseconds, and the
+		// number of playouts (0, the default, for no limit)
+		void setTimeBudget(const int ms);
+		void setMaxPlayouts(const unsigned long playouts);
+
+		// Number of threads to search with, including the calling thread.
+		// Defaults to the number of hardware threads available.
+		void setThreads(const unsigned int threads);
+
+		// Memory for the tree, in megabytes.  Once it's full, searches
+		// carry on without growing it.  Throws away the current tree.
+		void setTreeSize(const size_t mb);
+
+		// Seed the random number generator used for playouts, so that
+		// searches with one thread and a playout limit can be repeated
+		void setSeed(const unsigned int seed);
+
+		// Find the best move for the current player.  Returns false if the
+		// current player can't move at all.
+		bool findMove(const BoardState &b, PackedMove &best);
+
+		// Abandon the search in progress as soon as possible, and make any
+		// future searches return straight away.  Safe to call from any thread.
+		void cancel();
+
+		// Forget the tree, e.g. at the start of a new game
+		void clear();
+
+		// Statistics about the most recent search: playouts (by all
+		// threads), length of the longest line in the tree, and the chosen
+		// move's win rate in tenths of a percent
+		unsigned long getNodes() const
+		{
+			return m_Playouts;
+		};
+		int getDepth() const
+		{
+			return m_Depth;
+		};
+		int getScore() const
+		{
+			return m_Score;
+		};
+
+		// Nodes in the tree, including any kept from earlier searches
+		unsigned long getTreeSize() const
+		{
+			const uint32_t used = m_Used;
+			return (used < m_Capacity) ? used : m_Capacity;
+		};
+
+	private:
+		// A position in the tree.  Children are kept together in the node
+		// pool, in the order they were generated.
+		struct Node
+		{
+			// Visits, counted on the way down, and the total result for the
+			// player who moved here (see reward()), added on the way back up
+			std::atomic<uint32_t> visits;
+			std::atomic<uint32_t> reward;
+			// Index of the first child in the pool, and how many there are,
+			// once the node has been expanded
+			uint32_t children;
+			uint16_t count;
+			// Move which led here, and who made it (from 0 for player 1)
+			PackedMove move;
+			uint8_t player;
+			// Whether the node has children yet (see montecarlo.cxx)
+			std::atomic<uint8_t> state;
+		};
+
+		int m_TimeBudget;
+		unsigned long m_MaxPlayouts;
+		unsigned int m_Threads;
+		std::mt19937 m_Random;
+
+		// Node pool.  The root is always the first node.
+		std::unique_ptr<Node[]> m_pNodes;
+		uint32_t m_Capacity;
+		std::atomic<uint32_t> m_Used;
+
+		// Position at the root of the tree, if there is a tree
+		std::unique_ptr<BoardState> m_pRoot;
+
+		std::chrono::steady_clock::time_point m_Deadline;
+		std::atomic<bool> m_Stopped;
+		std::atomic<bool> m_Cancelled;
+		std::atomic<unsigned long> m_Playouts;
+		std::atomic<int> m_Depth;
+		int m_Score;
+
+		// Move the root of the tree to the given position, if it's in the
+		// tree, keeping just the part below it.  Otherwise start a new tree.
+		void reroot(const BoardState &b);
+
+		// Find the node for position "target" up to "plies" moves below node
+		// "n", whose position is "b", or return the capacity of the pool
+		uint32_t find(const uint32_t n, const BoardState &b, const BoardState &target,
+			const int plies) const;
+
+		// Give node "n", whose position is "b", a child for each move.
+		// Returns false if the pool is full.
+		bool expand(Node &n, const BoardState &b, PackedMove *moves);
+
+		// Body of each thread: repeatedly walk down the tree from the root,
+		// play the game out from where the walk leaves the tree, and pass
+		// the result back up, until time runs out
+		void work(const unsigned int seed);
+};
+
+#endif
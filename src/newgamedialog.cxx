@@ -144,6 +144,10 @@ void NewGameDialog::getGameType(GameType &gt) const
 		case 1:
 			gt.player_1 = pt_ai;
 			break;
+		case 2:
+			gt.player_1 = pt_ai;
+			gt.engine_1 = ae_montecarlo;
+			break;
 		default:
 			gt.player_1 = pt_remote;
 	}
@@ -155,6 +159,10 @@ void NewGameDialog::getGameType(GameType &gt) const
 		case 1:
 			gt.player_2 = pt_ai;
 			break;
+		case 2:
+			gt.player_2 = pt_ai;
+			gt.engine_2 = ae_montecarlo;
+			break;
 		default:
 			gt.player_2 = pt_remote;
 	}
@@ -170,6 +178,10 @@ void NewGameDialog::getGameType(GameType &gt) const
 			case 1:
 				gt.player_3 = pt_ai;
 				break;
+			case 2:
+				gt.player_3 = pt_ai;
+				gt.engine_3 = ae_montecarlo;
+				break;
 			default:
 				gt.player_3 = pt_remote;
 		}
@@ -181,6 +193,10 @@ void NewGameDialog::getGameType(GameType &gt) const
 			case 1:
 				gt.player_4 = pt_ai;
 				break;
+			case 2:
+				gt.player_4 = pt_ai;
+				gt.engine_4 = ae_montecarlo;
+				break;
 			default:
 				gt.player_4 = pt_remote;
 		}
@@ -0,0 +1,168 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "perft.hxx"
+
+//
+// Implementation
+//
+
+Perft::Perft()
+	: m_Threads(1), m_Mask(0)
+{
+}
+
+Perft::~Perft()
+{
+}
+
+void Perft::setHashSize(const size_t mb)
+{
+	if (mb == 0)
+	{
+		m_pCache.reset();
+		m_Mask = 0;
+		return;
+	}
+	size_t slots = 1;
+	while ((slots * 2 * 2 * sizeof(uint64_t)) <= (mb << 20))
+		slots *= 2;
+	m_pCache.reset(new std::atomic<uint64_t>[slots * 2]);
+	for (size_t i = 0; i < slots * 2; ++i)
+		m_pCache[i].store(0, std::memory_order_relaxed);
+	m_Mask = slots - 1;
+}
+
+void Perft::setThreads(const unsigned int threads)
+{
+	m_Threads = (threads > 0) ? threads : 1;
+}
+
+uint64_t Perft::count(const BoardState &b, const int depth)
+{
+	std::vector<std::pair<PackedMove, uint64_t> > results;
+	return divide(b, depth, results);
+}
+
+uint64_t Perft::divide(const BoardState &b, const int depth,
+	std::vector<std::pair<PackedMove, uint64_t> > &results)
+{
+	results.clear();
+	if (depth <= 0)
+		return 1;
+
+	std::vector<PackedMove> root(b.getMaxMoves());
+	root.resize(b.generateMoves(b.getPlayer(), root.data(), root.size()));
+	results.resize(root.size());
+
+	// Hand root moves out to the threads one at a time, since the size of
+	// the tree under each varies a lot
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < m_Threads; ++t)
+	{
+		threads.push_back(std::thread([&]()
+		{
+			BoardState board(b);
+			std::vector<PackedMove> moves(depth * board.getMaxMoves());
+			for (size_t i = next++; i < root.size(); i = next++)
+			{
+				results[i].first = root[i];
+				results[i].second = countAfter(board, root[i], depth - 1, moves.data());
+			}
+		}));
+	}
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+
+	uint64_t total = 0;
+	for (size_t i = 0; i < results.size(); ++i)
+		total += results[i].second;
+	return total;
+}
+
+uint64_t Perft::countAfter(BoardState &b, const PackedMove m, const int depth,
+	PackedMove *moves)
+{
+	piece mover = b.getPlayer();
+	MoveUndo u = b.makeMove(m);
+	uint64_t n;
+	if (depth == 0)
+		n = 1;
+	else if (!b.skipBlockedPlayers(mover))
+		// Game over
+		n = 0;
+	else
+		n = count(b, depth, moves);
+	b.unmakeMove(u);
+	return n;
+}
+
+uint64_t Perft::count(BoardState &b, const int depth, PackedMove *moves)
+{
+	// Reflections and rotations of a position have the same number of lines
+	int symmetry;
+	uint64_t key = b.getCanonicalHash(symmetry) ^ ((uint64_t)depth * 0x9e3779b97f4a7c15ULL);
+	size_t slot = (key & m_Mask) * 2;
+	if (m_pCache)
+	{
+		uint64_t check = m_pCache[slot].load(std::memory_order_relaxed);
+		uint64_t n = m_pCache[slot + 1].load(std::memory_order_relaxed);
+		if ((check ^ n) == key)
+			return n;
+	}
+
+	// The last ply doesn't need making: every move leads to one position
+	unsigned int nmoves = b.generateMoves(b.getPlayer(), moves, b.getMaxMoves());
+	uint64_t n = 0;
+	if (depth == 1)
+		n = nmoves;
+	else
+	{
+		for (unsigned int i = 0; i < nmoves; ++i)
+			n += countAfter(b, moves[i], depth - 1, moves + nmoves);
+	}
+
+	if (m_pCache)
+	{
+		m_pCache[slot].store(key ^ n, std::memory_order_relaxed);
+		m_pCache[slot + 1].store(n, std::memory_order_relaxed);
+	}
+	return n;
+}
@@ -0,0 +1,69 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_PERFT_HXX
+#define INFECTOR_PERFT_HXX
+
+class BoardState;
+
+// Count the positions reached by every sequence of moves of a given length
+// ("perft"), for checking move generation against other implementations
+// and measuring its speed.
+//
+// Moves are as listed by BoardState::generateMoves, so cloning into a square
+// counts once however many pieces could make the clone.  Players who can't
+// move have their turn skipped, as in a real game, which doesn't count as a
+// move; once nobody can move the game is over, and the sequence ends there
+// (contributing nothing unless it's already the right length).
+class Perft
+{
+	public:
+		Perft();
+		~Perft();
+
+		// Cache counts for positions seen before in a table of the given
+		// size in megabytes, or don't cache at all if zero
+		void setHashSize(const size_t mb);
+
+		// Number of threads to split the moves from the root between
+		void setThreads(const unsigned int threads);
+
+		// Count sequences of "depth" moves from the given position
+		uint64_t count(const BoardState &b, const int depth);
+
+		// Same again, but broken down by the first move
+		uint64_t divide(const BoardState &b, const int depth,
+			std::vector<std::pair<PackedMove, uint64_t> > &results);
+
+	private:
+		unsigned int m_Threads;
+
+		// Cache of counts: two words per slot, key ^ count then count, so
+		// that threads can share it without locking (see
+		// TranspositionTable).  Keys mix in the remaining depth.
+		std::unique_ptr<std::atomic<uint64_t>[]> m_pCache;
+		size_t m_Mask;
+
+		// Count sequences from a position, with a move list to work in
+		uint64_t count(BoardState &b, const int depth, PackedMove *moves);
+
+		// Count sequences after making a move, including any skipped turns
+		uint64_t countAfter(BoardState &b, const PackedMove m, const int depth,
+			PackedMove *moves);
+};
+
+#endif
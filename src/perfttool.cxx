@@ -0,0 +1,211 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Command line front end to Perft: count move sequences from a position and
+// report how long it took.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "perft.hxx"
+
+//
+// Implementation
+//
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [options] DEPTH [MOVE...]\n"
+		"  -B BOARD   board to play on (default \"sq7\")\n"
+		"  -H MB      cache counts in a hash table of this size\n"
+		"  -j JOBS    threads to split the work between (default: one per CPU)\n"
+		"  -d         break the final count down by first move\n"
+		"BOARD is \"sqN\" or \"hexN\", with \"/4\" appended for four players.\n"
+		"Each MOVE is \"x,y-x,y\", and is made from the starting position\n"
+		"before counting, with blocked players' turns skipped as usual.\n",
+		argv0);
+}
+
+static bool parseBoard(const char *text, GameType &gt)
+{
+	if (strncmp(text, "sq", 2) == 0)
+	{
+		gt.square = true;
+		text += 2;
+	} else if (strncmp(text, "hex", 3) == 0) {
+		gt.square = false;
+		text += 3;
+	} else {
+		return false;
+	}
+	char *end;
+	gt.w = gt.h = strtol(text, &end, 10);
+	gt.player_1 = pt_ai;
+	gt.player_2 = pt_ai;
+	if (strcmp(end, "/4") == 0)
+	{
+		if (!gt.square)
+			return false;
+		gt.player_3 = pt_ai;
+		gt.player_4 = pt_ai;
+	}
+	else if (*end != '\0')
+		return false;
+	return BoardGeometry::supported(gt.square, gt.w, gt.h);
+}
+
+// Make a move given as "x,y-x,y", if it's legal
+static bool playMove(BoardState &b, const char *text)
+{
+	move m;
+	if (sscanf(text, "%d,%d-%d,%d", &m.source_x, &m.source_y, &m.dest_x, &m.dest_y) != 4)
+		return false;
+	piece p = b.getPlayer();
+	if ((b.getPieceAt(m.source_x, m.source_y) != p)
+		|| (b.getPieceAt(m.dest_x, m.dest_y) != pc_player_none)
+		|| (b.getAdjacency(m.source_x, m.source_y, m.dest_x, m.dest_y) == 0))
+	{
+		return false;
+	}
+	b.makeMove(b.packMove(m));
+	if (!b.skipBlockedPlayers(p))
+		fprintf(stderr, "Warning: game over after %s\n", text);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	GameType gt;
+	parseBoard("sq7", gt);
+	size_t hash = 0;
+	unsigned int jobs = std::thread::hardware_concurrency();
+	bool divide = false;
+
+	int i = 1;
+	for (; (i < argc) && (argv[i][0] == '-'); ++i)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = true;
+		if (strcmp(argv[i], "-d") == 0)
+		{
+			divide = true;
+			continue;
+		}
+		else if (value && (strcmp(argv[i], "-B") == 0))
+		{
+			gt = GameType();
+			ok = parseBoard(value, gt);
+		}
+		else if (value && (strcmp(argv[i], "-H") == 0))
+		{
+			// Checked before they go into "hash" and "jobs", which are
+			// unsigned
+			const int n = atoi(value);
+			ok = (n >= 0);
+			if (ok)
+				hash = n;
+		}
+		else if (value && (strcmp(argv[i], "-j") == 0))
+		{
+			const int n = atoi(value);
+			ok = (n > 0);
+			if (ok)
+				jobs = n;
+		}
+		else
+			ok = false;
+		if (!ok)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+	if (i == argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	int depth = atoi(argv[i++]);
+	if (depth <= 0)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	BoardState b(&gt);
+	for (; i < argc; ++i)
+	{
+		if (!playMove(b, argv[i]))
+		{
+			fprintf(stderr, "Illegal move: %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	Perft perft;
+	perft.setThreads(jobs);
+	for (int d = 1; d <= depth; ++d)
+	{
+		// Start each depth afresh, so the times are comparable
+		perft.setHashSize(hash);
+		std::vector<std::pair<PackedMove, uint64_t> > results;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		uint64_t n = perft.divide(b, d, results);
+		double elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+
+		if (divide && (d == depth))
+		{
+			for (size_t j = 0; j < results.size(); ++j)
+			{
+				move m = b.unpackMove(results[j].first);
+				printf("%d,%d-%d,%d: %llu\n", m.source_x, m.source_y, m.dest_x,
+					m.dest_y, (unsigned long long)results[j].second);
+			}
+		}
+		printf("depth %2d: %15llu  %9.3fs  %8.2f Mnodes/s\n", d,
+			(unsigned long long)n, elapsed, (elapsed > 0) ? (n / elapsed / 1e6) : 0.0);
+		fflush(stdout);
+	}
+	return 0;
+}
@@ -0,0 +1,270 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardkernel.hxx"
+#include "boardstate.hxx"
+#include "playout.hxx"
+
+//
+// Globals
+//
+
+// Playouts are compiled for the same CPUs as feature counting is in
+// evaluator.cxx.  Having POPCNT makes most of the difference in speed.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(MINGW)
+#define PLAYOUT_KERNEL __attribute__((target_clones("avx2", "popcnt", "default")))
+#else
+#define PLAYOUT_KERNEL
+#endif
+
+//
+// Implementation
+//
+
+// Random number from 0 to n - 1
+static inline int below(std::mt19937 &random, const int n)
+{
+	return (int)(((uint64_t)random() * (uint32_t)n) >> 32);
+}
+
+// The k'th square (from 0) in "set"
+template <class Board> static KERNEL_INLINE int pick(const BoardGeometry &g,
+	const Bitboard &set, int k)
+{
+	const int words = Board::words(g);
+	for (int i = 0; i < words; ++i)
+	{
+		const int c = __builtin_popcountll(set.words[i]);
+		if (k < c)
+		{
+			uint64_t w = set.words[i];
+			for (; k > 0; --k)
+				w &= w - 1;
+			return (i << 6) + __builtin_ctzll(w);
+		}
+		k -= c;
+	}
+	return -1;
+}
+
+// Set "out" to the squares in "mask" at exactly the given distance (0 for
+// clones, 1 for jumps) from some square in "in", and return how many
+template <class Board> static KERNEL_INLINE int near(const BoardGeometry &g,
+	Bitboard &out, const Bitboard &in, const Bitboard &mask, const int d)
+{
+	const int words = Board::words(g), size = Board::ringsize(g, d);
+	for (int i = 0; i < words; ++i)
+		out.words[i] = 0;
+	KERNEL_UNROLL
+	for (int r = 0; r < size; ++r)
+		out.orShifted(in, words, Board::ring(g, d, r));
+	int count = 0;
+	for (int i = 0; i < words; ++i)
+	{
+		out.words[i] &= mask.words[i];
+		count += __builtin_popcountll(out.words[i]);
+	}
+	return count;
+}
+
+// The playout itself, on the given layout.  "last" is left as the player
+// who moved last (or the player who started, if nobody could move).
+template <class Board> static KERNEL_INLINE int playoutOn(const BoardGeometry &g,
+	Bitboard pieces[4], const int players, int p, std::mt19937 &random,
+	const playoutpolicy policy, const int limit, int &last, bool &finished)
+{
+	const int words = Board::words(g), directions = Board::ringsize(g, 1);
+	Bitboard empty, targets, others, captures;
+	// Squares each jump direction lands on, and how many of them
+	Bitboard jumps[16];
+	int counts[16] = { 0 };
+
+	for (int i = 0; i < words; ++i)
+	{
+		empty.words[i] = g.valid.words[i] & ~(pieces[0].words[i] | pieces[1].words[i]
+			| pieces[2].words[i] | pieces[3].words[i]);
+	}
+
+	int moves = 0;
+	last = p;
+	finished = false;
+	for (;;)
+	{
+		Bitboard &mine = pieces[p];
+
+		// Moves are numbered clones first, then jumps in each direction
+		// in turn, so a random number picks one straight from the counts.
+		// Jumps don't need counting if only clones will be considered.
+		int clones = near<Board>(g, targets, mine, empty, 0);
+		if ((policy == pp_captures) && clones)
+		{
+			for (int i = 0; i < words; ++i)
+				others.words[i] = g.valid.words[i] & ~(mine.words[i] | empty.words[i]);
+			const int n = near<Board>(g, captures, others, targets, 0);
+			if (n)
+			{
+				targets = captures;
+				clones = n;
+			}
+		}
+		int total = clones;
+		if ((policy == pp_uniform) || !clones)
+		{
+			KERNEL_UNROLL
+			for (int r = 0; r < directions; ++r)
+			{
+				Bitboard &j = jumps[r];
+				for (int i = 0; i < words; ++i)
+					j.words[i] = 0;
+				j.orShifted(mine, words, Board::ring(g, 1, r));
+				counts[r] = 0;
+				for (int i = 0; i < words; ++i)
+				{
+					j.words[i] &= empty.words[i];
+					counts[r] += __builtin_popcountll(j.words[i]);
+				}
+				total += counts[r];
+			}
+		}
+
+		// Players who can't move are skipped, and the game is over once
+		// play comes back round to whoever moved last.  That's checked
+		// before stopping at the limit, so that a game which ended on the
+		// last move allowed is still finished.
+		if (total == 0)
+		{
+			p = (p + 1) % players;
+			if (p == last)
+			{
+				finished = true;
+				break;
+			}
+			continue;
+		}
+		if (limit && (moves == limit))
+			break;
+
+		int k = below(random, total);
+		int dest;
+		if (k < clones)
+			dest = pick<Board>(g, targets, k);
+		else
+		{
+			k -= clones;
+			int r = 0;
+			while (k >= counts[r])
+				k -= counts[r++];
+			dest = pick<Board>(g, jumps[r], k);
+			const int source = g.jumpSource(dest, r);
+			mine.reset(source);
+			empty.set(source);
+		}
+		mine.set(dest);
+		empty.reset(dest);
+
+		// Take over the neighbouring pieces, whoever they belong to
+		const uint16_t *end = g.endRing(dest, 1);
+		for (const uint16_t *s = g.beginRing(dest, 1); s != end; ++s)
+		{
+			if (empty.test(*s) || mine.test(*s))
+				continue;
+			for (int q = 0; q < players; ++q)
+				pieces[q].reset(*s);
+			mine.set(*s);
+		}
+
+		last = p;
+		p = (p + 1) % players;
+		++moves;
+	}
+
+	if (finished)
+	{
+		// The last player to move gets every empty square, and every
+		// piece next to one
+		near<Board>(g, targets, empty, g.valid, 0);
+		for (int i = 0; i < words; ++i)
+			targets.words[i] |= empty.words[i];
+		for (int q = 0; q < players; ++q)
+		{
+			for (int i = 0; i < words; ++i)
+				pieces[q].words[i] &= ~targets.words[i];
+		}
+		for (int i = 0; i < words; ++i)
+			pieces[last].words[i] |= targets.words[i];
+	}
+	return moves;
+}
+
+PLAYOUT_KERNEL
+int playout(const BoardState &b, std::mt19937 &random, const playoutpolicy policy,
+	const int limit, int scores[4], bool &finished)
+{
+	const BoardGeometry &g = *b.getGeometry();
+	b.getScores(scores[0], scores[1], scores[2], scores[3]);
+	const int players = (scores[2] == -1) ? 2 : 4;
+
+	// Only the words in use are copied, since most boards need few
+	Bitboard pieces[4];
+	for (int q = 0; q < 4; ++q)
+	{
+		const Bitboard &from = b.getPieces((piece)(pc_player_1 + q));
+		for (int i = 0; i < g.words; ++i)
+			pieces[q].words[i] = (q < players) ? from.words[i] : 0;
+	}
+
+	const int p = b.getPlayer() - pc_player_1;
+	int last, moves;
+	switch (g.kernel)
+	{
+		case bk_square_7:
+			moves = playoutOn<FixedBoard<true, 7> >(g, pieces, players, p, random, policy,
+				limit, last, finished);
+			break;
+		case bk_square_8:
+			moves = playoutOn<FixedBoard<true, 8> >(g, pieces, players, p, random, policy,
+				limit, last, finished);
+			break;
+		case bk_hex_5:
+			moves = playoutOn<FixedBoard<false, 5> >(g, pieces, players, p, random, policy,
+				limit, last, finished);
+			break;
+		default:
+			moves = playoutOn<AnyBoard>(g, pieces, players, p, random, policy, limit,
+				last, finished);
+	}
+
+	for (int q = 0; q < players; ++q)
+		scores[q] = pieces[q].count(g.words);
+	return moves;
+}
@@ -0,0 +1,48 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_PLAYOUT_HXX
+#define INFECTOR_PLAYOUT_HXX
+
+class BoardState;
+
+// Ways of picking moves at random in a playout
+enum playoutpolicy
+{
+	// Every legal move is equally likely, counting each jump separately
+	// and each square cloned into once, as BoardState::generateMoves lists
+	// them
+	pp_uniform,
+	// Clones before jumps, and clones which capture something before those
+	// which don't, but otherwise uniform
+	pp_captures
+};
+
+// Play a game on from the given position with random moves, working
+// directly on the bitboards, without generating move lists or keeping
+// hashes up to date.  Players who can't move are skipped; once nobody but
+// the last player to move can, the game is over, and the empty squares are
+// filled as in BoardState::fillEmpty.  The player to move must be able to,
+// as after BoardState::skipBlockedPlayers.
+//
+// Stops after "limit" moves, if it's not 0.  Fills in the scores as
+// BoardState::getScores would, and "finished" with whether the game ended.
+// Returns the number of moves made.
+int playout(const BoardState &b, std::mt19937 &random, const playoutpolicy policy,
+	const int limit, int scores[4], bool &finished);
+
+#endif
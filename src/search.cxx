@@ -0,0 +1,530 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "search.hxx"
+#include "symmetry.hxx"
+#include "transposition.hxx"
+#include "endgame.hxx"
+#include "book.hxx"
+#include "zobrist.hxx"
+
+//
+// Globals
+//
+
+// Moves are scored by the evaluator to help order them at the root, and
+// at nodes at least this many plies from the horizon.  Closer to it, there
+// are so many nodes, and so few of their moves searched before a cut-off,
+// that scoring all of them costs more than it saves.
+#define SEARCH_SCORE_DEPTH 4
+
+// Scores used for ordering are clamped to less than this either side of
+// zero, so they can be packed into a key underneath the rest
+#define SEARCH_SCORE_RANGE 50000
+
+//
+// Implementation
+//
+
+Search::Search()
+	: m_TimeBudget(400), m_MaxDepth(64), m_Random(time(NULL)), m_pTT(NULL),
+		m_EndgameEmpties(0), m_pBook(NULL), m_pBoard(NULL), m_Me(pc_player_1), m_MeKey(0),
+		m_Stopped(false), m_Cancelled(false), m_Id(0), m_Halted(false),
+		m_Nodes(0), m_Depth(0), m_Score(0)
+{
+	setThreads(std::thread::hardware_concurrency());
+}
+
+Search::Search(const unsigned int id)
+	: m_TimeBudget(400), m_MaxDepth(64), m_Random(time(NULL) + id), m_pTT(NULL),
+		m_EndgameEmpties(0), m_pBook(NULL), m_pBoard(NULL), m_Me(pc_player_1), m_MeKey(0),
+		m_Stopped(false), m_Cancelled(false), m_Id(id), m_Halted(false),
+		m_Nodes(0), m_Depth(0), m_Score(0)
+{
+}
+
+Search::~Search()
+{
+}
+
+void Search::setTimeBudget(const int ms)
+{
+	m_TimeBudget = ms;
+}
+
+void Search::setMaxDepth(const int depth)
+{
+	m_MaxDepth = depth;
+}
+
+void Search::setTranspositionTable(TranspositionTable *tt)
+{
+	m_pTT = tt;
+}
+
+void Search::setThreads(const unsigned int threads)
+{
+	// hardware_concurrency() returns 0 if it doesn't know
+	unsigned int helpers = (threads > 1) ? (threads - 1) : 0;
+	while (m_Helpers.size() > helpers)
+		m_Helpers.pop_back();
+	while (m_Helpers.size() < helpers)
+		m_Helpers.push_back(std::unique_ptr<Search>(new Search(m_Helpers.size() + 1)));
+}
+
+void Search::setSeed(const unsigned int seed)
+{
+	m_Random.seed(seed);
+	for (size_t i = 0; i < m_Helpers.size(); ++i)
+		m_Helpers[i]->setSeed(seed + i + 1);
+}
+
+void Search::setEndgameEmpties(const unsigned int empties)
+{
+	m_EndgameEmpties = empties;
+	if (empties == 0)
+		m_pEndgame.reset();
+	else if (!m_pEndgame)
+		m_pEndgame.reset(new EndgameSolver);
+}
+
+void Search::setWeights(const EvalWeights &w)
+{
+	m_Evaluator.setWeights(w);
+}
+
+void Search::setOpeningBook(const OpeningBook *book)
+{
+	m_pBook = book;
+}
+
+void Search::cancel()
+{
+	m_Cancelled = true;
+	if (m_pEndgame)
+		m_pEndgame->cancel();
+	for (size_t i = 0; i < m_Helpers.size(); ++i)
+		m_Helpers[i]->cancel();
+}
+
+void Search::clear()
+{
+	if (m_pEndgame)
+		m_pEndgame->clear();
+}
+
+// Find the best move for the current player
+bool Search::findMove(const BoardState &b, PackedMove &best)
+{
+	// Work on our own copy of the board, making and taking back moves in place
+	BoardState board(b);
+	m_pBoard = &board;
+	m_Me = board.getPlayer();
+	// Positions are scored from our point of view, so the same position
+	// searched for somebody else is a different table entry
+	m_MeKey = zobrist_searcher[m_Me - pc_player_1];
+	m_Nodes = 0;
+	m_Depth = 0;
+	m_Score = 0;
+	m_Stopped = false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	m_Deadline = start + std::chrono::milliseconds(m_TimeBudget);
+	int budget = m_TimeBudget;
+
+	// Root moves are shuffled before being ordered, so that we don't know
+	// which will come out on top if several have the same score
+	unsigned int n = orderedMoves(0, true, true);
+	if (n == 0)
+	{
+		m_pBoard = NULL;
+		return false;
+	}
+	std::vector<PackedMove> root(m_Moves.begin(), m_Moves.begin() + n);
+	best = root[0];
+	if (n == 1)
+	{
+		m_pBoard = NULL;
+		return true;
+	}
+
+	// Near the start of the game, see if the book knows what to do
+	PackedMove booked;
+	int score;
+	if (m_pBook && m_pBook->probe(board, booked, score))
+	{
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			if (root[i] == booked)
+			{
+				best = booked;
+				m_Score = score;
+				m_pBoard = NULL;
+				return true;
+			}
+		}
+	}
+
+	// Near the end of the game, try to work out the result for certain.
+	// If it can't be done in time, search normally for the rest of it.
+	if (m_pEndgame)
+	{
+		Bitboard empty;
+		board.getEmpty(empty);
+		if (empty.count(board.getGeometry()->words) <= (int)m_EndgameEmpties)
+		{
+			int margin;
+			PackedMove solved;
+			bool exact = m_pEndgame->solve(board, m_TimeBudget / 2, solved, margin);
+			m_Nodes += m_pEndgame->getNodes();
+			if (exact)
+			{
+				best = solved;
+				m_Depth = m_pEndgame->getHorizon();
+				if (margin > 0)
+					m_Score = SEARCH_WIN + margin;
+				else if (margin < 0)
+					m_Score = -SEARCH_WIN + margin;
+				m_pBoard = NULL;
+				return true;
+			}
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			budget -= std::chrono::duration_cast<std::chrono::milliseconds>(now - start).count();
+			start = now;
+		}
+	}
+
+	// Set helpers off on the same search.  They shuffle the root moves
+	// differently, and every other one starts a ply deeper, so that they
+	// don't all follow in each other's footsteps.
+	std::vector<std::thread> helpers;
+	if (m_pTT)
+	{
+		for (size_t i = 0; i < m_Helpers.size(); ++i)
+		{
+			Search *h = m_Helpers[i].get();
+			h->m_TimeBudget = budget;
+			h->m_MaxDepth = m_MaxDepth;
+			h->m_pTT = m_pTT;
+			h->m_Evaluator.setWeights(m_Evaluator.getWeights());
+			h->m_Halted = false;
+			helpers.push_back(std::thread(&Search::help, h, std::cref(b)));
+		}
+	}
+
+	// Iterative deepening.  The best move from each iteration is searched
+	// first in the next, so even an unfinished iteration tells us something
+	// as long as that first move was finished.
+	for (int depth = 1 + (m_Id & 1); depth <= m_MaxDepth; ++depth)
+	{
+		int alpha = -SEARCH_INFINITY;
+		int bestscore = -SEARCH_INFINITY;
+		unsigned int besti = 0;
+		unsigned int searched = 0;
+		for (unsigned int i = 0; i < n; ++i)
+		{
+			int v = tryMove(root[i], depth, alpha, SEARCH_INFINITY, n);
+			if (m_Stopped)
+				break;
+			++searched;
+			if (v > bestscore)
+			{
+				bestscore = v;
+				besti = i;
+				alpha = v;
+			}
+		}
+
+		if (searched > 0)
+		{
+			best = root[besti];
+			m_Score = bestscore;
+			std::rotate(root.begin(), root.begin() + besti, root.begin() + besti + 1);
+		}
+		if (m_Stopped)
+			break;
+		m_Depth = depth;
+
+		// Stop once the outcome is certain, or if there isn't enough time
+		// left for the next iteration to have a chance of finishing.
+		// Helpers keep going until the main thread has finished.
+		if ((bestscore >= SEARCH_WIN) || (bestscore <= -SEARCH_WIN))
+			break;
+		if ((m_Id == 0) && ((std::chrono::steady_clock::now() - start) * 2
+			> std::chrono::milliseconds(budget)))
+		{
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < helpers.size(); ++i)
+		m_Helpers[i]->m_Halted = true;
+	for (size_t i = 0; i < helpers.size(); ++i)
+	{
+		helpers[i].join();
+		m_Nodes += m_Helpers[i]->m_Nodes;
+	}
+
+	m_pBoard = NULL;
+	return true;
+}
+
+// Body of a helper thread: search the same position as the main thread,
+// throwing away the result (what matters is the transposition table)
+void Search::help(const BoardState &b)
+{
+	PackedMove m;
+	findMove(b, m);
+}
+
+// Score the current position from the point of view of the side to move
+int Search::negamax(const int depth, int alpha, int beta, const size_t base)
+{
+	++m_Nodes;
+	if (outOfTime())
+		return 0;
+
+	BoardState &b = *m_pBoard;
+	const BoardGeometry &g = *b.getGeometry();
+	const int alpha_orig = alpha;
+
+	// See if we've been here before, at this depth or deeper, or in any
+	// reflection or rotation of this position
+	int symmetry;
+	uint64_t key = b.getCanonicalHash(symmetry) ^ m_MeKey;
+	PackedMove hashed = PackedMove::none();
+	TTEntry e;
+	if (m_pTT && m_pTT->probe(key, e))
+	{
+		if (e.depth >= depth)
+		{
+			if ((e.bound == tb_exact)
+				|| ((e.bound == tb_lower) && (e.score >= beta))
+				|| ((e.bound == tb_upper) && (e.score <= alpha)))
+			{
+				return e.score;
+			}
+		}
+		hashed = fromCanonical(g, symmetry, e.best);
+	}
+
+	unsigned int n = 0;
+	if (depth > 0)
+		n = orderedMoves(base, false, depth >= SEARCH_SCORE_DEPTH, hashed);
+	if (n == 0)
+	{
+		int v = m_Evaluator.evaluate(b, m_Me);
+		if (b.getPlayer() != m_Me)
+			v = -v;
+		if (m_pTT)
+			m_pTT->store(key, v, 0, tb_exact, PackedMove::none());
+		return v;
+	}
+
+	int best = -SEARCH_INFINITY;
+	unsigned int besti = 0;
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		// Deeper plies may grow the move stack, so take a copy
+		PackedMove m(m_Moves[base + i]);
+		int v = tryMove(m, depth, alpha, beta, base + n);
+		if (m_Stopped)
+			return 0;
+		if (v > best)
+		{
+			best = v;
+			besti = i;
+			if (v > alpha)
+			{
+				alpha = v;
+				if (alpha >= beta)
+					break;
+			}
+		}
+	}
+
+	if (m_pTT)
+	{
+		ttbound bound = tb_exact;
+		if (best <= alpha_orig)
+			bound = tb_upper;
+		else if (best >= beta)
+			bound = tb_lower;
+		m_pTT->store(key, best, depth, bound,
+			toCanonical(g, symmetry, m_Moves[base + besti]));
+	}
+	return best;
+}
+
+// Make a move and find out the value of the resulting position from the
+// point of view of the player who made it
+int Search::tryMove(const PackedMove m, const int depth, const int alpha, const int beta,
+	const size_t base)
+{
+	BoardState &b = *m_pBoard;
+	piece side = b.getPlayer();
+	MoveUndo u = b.makeMove(m);
+
+	int v;
+	if (!b.skipBlockedPlayers(side))
+	{
+		// Nobody else can move, so the game is over
+		v = finalScore(side);
+		if (side != m_Me)
+			v = -v;
+	}
+	else if ((b.getPlayer() == m_Me) == (side == m_Me))
+		// Still the same side's turn (opponents in a paranoid search)
+		v = negamax(depth - 1, alpha, beta, base);
+	else
+		v = -negamax(depth - 1, -beta, -alpha, base);
+
+	b.unmakeMove(u);
+	return v;
+}
+
+// Generate moves for the current player into the move stack at "base",
+// and sort them so the most promising are searched first: the given move
+// (if any), then captures, then clones before jumps, and if "evaluate" is
+// set, the best scoring positions first among moves which are otherwise
+// alike.
+unsigned int Search::orderedMoves(const size_t base, const bool shuffle,
+	const bool evaluate, const PackedMove first)
+{
+	BoardState &b = *m_pBoard;
+	const BoardGeometry &g = *b.getGeometry();
+	size_t needed = base + b.getMaxMoves();
+	if (m_Moves.size() < needed)
+	{
+		m_Moves.resize(needed);
+		m_Keys.resize(needed);
+	}
+
+	PackedMove *moves = &m_Moves[base];
+	int *keys = &m_Keys[base];
+	unsigned int n = b.generateMoves(b.getPlayer(), moves, b.getMaxMoves());
+	if (shuffle)
+		std::shuffle(moves, moves + n, m_Random);
+
+	const Bitboard &mine = b.getPieces(b.getPlayer());
+	Bitboard empty;
+	b.getEmpty(empty);
+	if (evaluate)
+		m_Evaluator.evaluateMoves(b, m_Me, moves, n, keys);
+	for (unsigned int i = 0; i < n; ++i)
+	{
+		int d = moves[i].dest();
+		int captures = 0;
+		const uint16_t *end = g.endRing(d, 1);
+		for (const uint16_t *j = g.beginRing(d, 1); j != end; ++j)
+		{
+			if (!mine.test(*j) && !empty.test(*j))
+				++captures;
+		}
+		int key = (captures * 2) + (moves[i].isClone() ? 1 : 0);
+
+		// Scores are from our point of view; opponents want them low
+		if (evaluate)
+		{
+			int score = (b.getPlayer() == m_Me) ? keys[i] : -keys[i];
+			score = std::max(-SEARCH_SCORE_RANGE + 1, std::min(SEARCH_SCORE_RANGE - 1, score));
+			key = (key * SEARCH_SCORE_RANGE * 2) + score;
+		}
+
+		// Best move from the last time we saw this position goes first
+		if (moves[i] == first)
+			key = SEARCH_INFINITY;
+		keys[i] = key;
+	}
+
+	// Insertion sort, highest key first; lists are short
+	for (unsigned int i = 1; i < n; ++i)
+	{
+		PackedMove m(moves[i]);
+		int k = keys[i];
+		unsigned int j = i;
+		for (; (j > 0) && (keys[j - 1] < k); --j)
+		{
+			moves[j] = moves[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		moves[j] = m;
+		keys[j] = k;
+	}
+
+	return n;
+}
+
+// Score for a finished game, after "mover" made the last move: a win or
+// loss, plus the final margin between us and our best opponent
+int Search::finalScore(const piece mover) const
+{
+	int scores[4];
+	m_pBoard->getFilledScores(mover, scores[0], scores[1], scores[2], scores[3]);
+	int other = -1;
+	for (int i = 0; i < 4; ++i)
+	{
+		if ((i != m_Me - pc_player_1) && (scores[i] > other))
+			other = scores[i];
+	}
+	int margin = scores[m_Me - pc_player_1] - other;
+	if (margin > 0)
+		return SEARCH_WIN + margin;
+	else if (margin < 0)
+		return -SEARCH_WIN + margin;
+	return 0;
+}
+
+// Check the clock every so often, and note if we've run out of time,
+// been cancelled, or (for helpers) the main thread has finished
+bool Search::outOfTime()
+{
+	if (!m_Stopped && (m_Cancelled.load(std::memory_order_relaxed)
+		|| m_Halted.load(std::memory_order_relaxed)
+		|| (((m_Nodes & 63) == 0)
+			&& (std::chrono::steady_clock::now() >= m_Deadline))))
+	{
+		m_Stopped = true;
+	}
+	return m_Stopped;
+}
@@ -0,0 +1,176 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_SEARCH_HXX
+#define INFECTOR_SEARCH_HXX
+
+class BoardState;
+class TranspositionTable;
+class EndgameSolver;
+class OpeningBook;
+
+// Score for a won game, before adding the final margin
+#define SEARCH_WIN 1000000
+#define SEARCH_INFINITY 10000000
+
+// Alpha-beta game tree search.
+// Games with more than two players are searched "paranoid" style: the
+// player we're choosing a move for tries to maximise their score, and
+// everybody else is assumed to be working together to minimise it.
+//
+// Searches can use several threads ("Lazy SMP"): helper threads search the
+// same position alongside the main one, in a slightly different order,
+// filling in the shared transposition table as they go so that the main
+// thread finds more of its work already done.  Without a transposition
+// table the helpers would be wasted, so none are used.
+//
+// Near the end of the game, positions can be handed over to an
+// EndgameSolver, which plays them out to the end instead of guessing.
+class Search
+{
+	public:
+		Search();
+		~Search();
+
+		// Limits for each search: thinking time in milliseconds, and maximum
+		// depth in plies
+		void setTimeBudget(const int ms);
+		void setMaxDepth(const int depth);
+
+		// Share results between searches through the given transposition
+		// table, or don't use one if NULL.  The table isn't owned by us.
+		void setTranspositionTable(TranspositionTable *tt);
+
+		// Number of threads to search with, including the calling thread.
+		// Defaults to the number of hardware threads available.
+		void setThreads(const unsigned int threads);
+
+		// Seed the random number generator used to choose between equally
+		// good moves, so that searches can be repeated
+		void setSeed(const unsigned int seed);
+
+		// Try to solve positions with at most this many empty squares
+		// exactly, spending up to half the time budget on it, before falling
+		// back on a normal search.  Zero (the default) turns this off.
+		void setEndgameEmpties(const unsigned int empties);
+
+		// Score positions with the given evaluation weights
+		void setWeights(const EvalWeights &w);
+
+		// Play moves from the given opening book when it has them, instead
+		// of searching, or don't use a book if NULL.  The book isn't owned
+		// by us.
+		void setOpeningBook(const OpeningBook *book);
+
+		// Find the best move for the current player.  Returns false if the
+		// current player can't move at all.
+		bool findMove(const BoardState &b, PackedMove &best);
+
+		// Abandon the search in progress as soon as possible, and make any
+		// future searches return straight away.  Safe to call from any thread.
+		void cancel();
+
+		// Forget what earlier searches learnt about particular positions,
+		// e.g. at the start of a new game.  The transposition table isn't
+		// ours, so that has to be cleared separately.
+		void clear();
+
+		// Statistics about the most recent search: nodes visited (by all
+		// threads), depth of the deepest completed iteration, and the score
+		// of the chosen move
+		unsigned long getNodes() const
+		{
+			return m_Nodes;
+		};
+		int getDepth() const
+		{
+			return m_Depth;
+		};
+		int getScore() const
+		{
+			return m_Score;
+		};
+
+	private:
+		// Constructor for helpers, which have no helpers of their own
+		explicit Search(const unsigned int id);
+
+		int m_TimeBudget;
+		int m_MaxDepth;
+		Evaluator m_Evaluator;
+		std::mt19937 m_Random;
+		TranspositionTable *m_pTT;
+
+		// Endgame solver, only created if it's turned on
+		unsigned int m_EndgameEmpties;
+		std::unique_ptr<EndgameSolver> m_pEndgame;
+
+		const OpeningBook *m_pBook;
+
+		// State of the search in progress: the board moves are made on, the
+		// player we're searching for, and a stack of generated moves with
+		// their ordering keys (each ply uses the space after its parent's)
+		BoardState *m_pBoard;
+		piece m_Me;
+		uint64_t m_MeKey;
+		std::vector<PackedMove> m_Moves;
+		std::vector<int> m_Keys;
+
+		std::chrono::steady_clock::time_point m_Deadline;
+		bool m_Stopped;
+		std::atomic<bool> m_Cancelled;
+
+		// Helper threads' searches, and for helpers, which one this is and
+		// a flag the main thread sets when it's finished
+		std::vector<std::unique_ptr<Search> > m_Helpers;
+		unsigned int m_Id;
+		std::atomic<bool> m_Halted;
+		unsigned long m_Nodes;
+		int m_Depth;
+		int m_Score;
+
+		// Body of a helper thread
+		void help(const BoardState &b);
+
+		// Score the current position from the point of view of the side to
+		// move, searching "depth" plies ahead.  Moves for this ply are stored
+		// in the move stack starting from "base".
+		int negamax(const int depth, int alpha, int beta, const size_t base);
+
+		// Make a move and find out the value of the resulting position from
+		// the point of view of the player who made it
+		int tryMove(const PackedMove m, const int depth, const int alpha, const int beta,
+			const size_t base);
+
+		// Generate moves for the current player into the move stack at "base"
+		// and sort them so the most promising are searched first, optionally
+		// shuffling them first to pick between equally promising moves.
+		// If "evaluate" is set, all the moves are scored by the evaluator in
+		// one go to break ties between them.  The given move, if any, is put
+		// in front of all the others.
+		unsigned int orderedMoves(const size_t base, const bool shuffle,
+			const bool evaluate, const PackedMove first = PackedMove::none());
+
+		// Score for a finished game, after "mover" made the last move
+		int finalScore(const piece mover) const;
+
+		// Check the clock every so often, and note if we've run out of time,
+		// been cancelled, or (for helpers) the main thread has finished
+		bool outOfTime();
+};
+
+#endif
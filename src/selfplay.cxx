@@ -0,0 +1,535 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+// Headless self-play: pit two AI configurations against each other over
+// many games, on as many cores as are available, and report the results.
+// Doesn't need GTK, so it can run on machines without a display.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "search.hxx"
+#include "transposition.hxx"
+#include "book.hxx"
+#include "montecarlo.hxx"
+
+//
+// Types
+//
+
+// Settings for one side of a matchup, parsed from "key=value,..."
+struct EngineSpec
+{
+	std::string text;
+	aiengine engine;
+	int time;
+	int depth;
+	int hash;
+	int endgame;
+	int tree;
+	unsigned long playouts;
+	std::string book;
+	EvalWeights weights;
+	EngineSpec()
+		: engine(ae_alphabeta), time(50), depth(64), hash(4),
+			endgame(INFECTOR_ENDGAME_EMPTIES), tree(16), playouts(0)
+	{};
+};
+
+// A board to play on, written "sq8" or "hex5", with "/4" on the end for
+// four players
+struct BoardSpec
+{
+	std::string text;
+	bool square;
+	int size;
+	int players;
+};
+
+// A position from a game, as the difference between its evaluation features
+// (see Evaluator::getFeatures) for the player to move and for their main
+// rival, and which side the player to move was on
+struct Sample
+{
+	int side;
+	int features[EVAL_FEATURES];
+};
+
+// One worker's engines for both sides, set up once and reused for every
+// game it plays
+struct Engines
+{
+	std::unique_ptr<TranspositionTable> tts[2];
+	std::unique_ptr<Search> searches[2];
+	std::unique_ptr<MonteCarloSearch> trees[2];
+};
+
+// Running totals for one board, from side A's point of view
+struct Tally
+{
+	int games;
+	int wins, draws, losses;
+	unsigned long nodes[2];
+	unsigned long moves[2];
+	Tally()
+		: games(0), wins(0), draws(0), losses(0)
+	{
+		nodes[0] = nodes[1] = 0;
+		moves[0] = moves[1] = 0;
+	};
+};
+
+//
+// Implementation
+//
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -a SPEC    settings for side A (default \"time=50\")\n"
+		"  -b SPEC    settings for side B (default \"time=50\")\n"
+		"  -B LIST    boards to play on, comma separated (default \"sq7\")\n"
+		"  -n GAMES   games per board (default 20)\n"
+		"  -j JOBS    games to play at once (default: one per CPU)\n"
+		"  -s SEED    random seed (default: time of day)\n"
+		"  -o FILE    write every position played, with how the game\n"
+		"             turned out, to FILE for infector-tune\n"
+		"SPEC is a comma separated list of:\n"
+		"  engine=E   \"alphabeta\" (the default) or \"mcts\" (Monte Carlo)\n"
+		"  time=MS    thinking time per move\n"
+		"  depth=N    maximum search depth (alphabeta)\n"
+		"  hash=MB    transposition table size (alphabeta)\n"
+		"  endgame=N  solve exactly with N empty squares left (0 for never;\n"
+		"             alphabeta)\n"
+		"  book=FILE  play from the given opening book (alphabeta)\n"
+		"  weights=FILE\n"
+		"             evaluate positions with the given weights (alphabeta)\n"
+		"  tree=MB    search tree size (mcts)\n"
+		"  playouts=N maximum playouts per move, 0 for no limit (mcts)\n"
+		"Boards are \"sqN\" or \"hexN\", with \"/4\" appended for four\n"
+		"players (square boards only).  Sides swap seats every game.\n"
+		"Nodes per move are counted in playouts for mcts.\n",
+		argv0);
+}
+
+static bool parseEngine(const char *text, EngineSpec &e)
+{
+	e.text = text;
+	std::string s(text);
+	size_t pos = 0;
+	while (pos < s.size())
+	{
+		size_t comma = s.find(',', pos);
+		if (comma == std::string::npos)
+			comma = s.size();
+		std::string item(s, pos, comma - pos);
+		pos = comma + 1;
+
+		size_t eq = item.find('=');
+		if (eq == std::string::npos)
+			return false;
+		std::string key(item, 0, eq);
+		if (key == "book")
+		{
+			e.book.assign(item, eq + 1, std::string::npos);
+			continue;
+		}
+		if (key == "weights")
+		{
+			if (!e.weights.load(item.c_str() + eq + 1))
+				return false;
+			continue;
+		}
+		if (key == "engine")
+		{
+			std::string value(item, eq + 1);
+			if (value == "alphabeta")
+				e.engine = ae_alphabeta;
+			else if (value == "mcts")
+				e.engine = ae_montecarlo;
+			else
+				return false;
+			continue;
+		}
+		int value = atoi(item.c_str() + eq + 1);
+		if (key == "time")
+			e.time = value;
+		else if (key == "depth")
+			e.depth = value;
+		else if (key == "hash")
+			e.hash = value;
+		else if (key == "endgame")
+			e.endgame = value;
+		else if (key == "tree")
+			e.tree = value;
+		else if (key == "playouts")
+			e.playouts = std::max(value, 0);
+		else
+			return false;
+	}
+	return (e.time > 0) && (e.depth > 0) && (e.hash > 0) && (e.endgame >= 0)
+		&& (e.tree > 0);
+}
+
+static bool parseBoards(const char *text, std::vector<BoardSpec> &boards)
+{
+	std::string s(text);
+	size_t pos = 0;
+	while (pos < s.size())
+	{
+		size_t comma = s.find(',', pos);
+		if (comma == std::string::npos)
+			comma = s.size();
+		BoardSpec b;
+		b.text.assign(s, pos, comma - pos);
+		pos = comma + 1;
+
+		const char *c = b.text.c_str();
+		if (strncmp(c, "sq", 2) == 0)
+		{
+			b.square = true;
+			c += 2;
+		} else if (strncmp(c, "hex", 3) == 0) {
+			b.square = false;
+			c += 3;
+		} else {
+			return false;
+		}
+		char *end;
+		b.size = strtol(c, &end, 10);
+		b.players = 2;
+		if (strcmp(end, "/4") == 0)
+			b.players = 4;
+		else if (*end != '\0')
+			return false;
+		if (((b.players == 4) && !b.square)
+			|| !BoardGeometry::supported(b.square, b.size, b.size))
+		{
+			return false;
+		}
+		boards.push_back(b);
+	}
+	return !boards.empty();
+}
+
+static void setupEngines(const EngineSpec specs[2], const OpeningBook books[2],
+	Engines &e)
+{
+	for (int i = 0; i < 2; ++i)
+	{
+		if (specs[i].engine == ae_montecarlo)
+		{
+			e.trees[i].reset(new MonteCarloSearch);
+			e.trees[i]->setThreads(1);
+			e.trees[i]->setTimeBudget(specs[i].time);
+			e.trees[i]->setMaxPlayouts(specs[i].playouts);
+			e.trees[i]->setTreeSize(specs[i].tree);
+			continue;
+		}
+		e.tts[i].reset(new TranspositionTable(specs[i].hash));
+		e.searches[i].reset(new Search);
+		e.searches[i]->setThreads(1);
+		e.searches[i]->setTimeBudget(specs[i].time);
+		e.searches[i]->setMaxDepth(specs[i].depth);
+		e.searches[i]->setTranspositionTable(e.tts[i].get());
+		e.searches[i]->setEndgameEmpties(specs[i].endgame);
+		e.searches[i]->setWeights(specs[i].weights);
+		if (!specs[i].book.empty())
+			e.searches[i]->setOpeningBook(&books[i]);
+	}
+}
+
+// Play one game.  Side A takes players 1 and 3 in even-numbered games, and
+// players 2 and 4 in odd-numbered ones.  Returns 1 if side A won, 0 for a
+// draw, or -1 if side B won.  If "samples" isn't NULL, every position is
+// added to it.
+static int playGame(const BoardSpec &spec, Engines &e, const int game,
+	const unsigned int seed, Tally &t, std::vector<Sample> *samples)
+{
+	GameType gt;
+	gt.square = spec.square;
+	gt.w = spec.size;
+	gt.h = spec.size;
+	gt.player_1 = pt_ai;
+	gt.player_2 = pt_ai;
+	if (spec.players == 4)
+	{
+		gt.player_3 = pt_ai;
+		gt.player_4 = pt_ai;
+	}
+	BoardState b(&gt);
+
+	// Every game starts from scratch, so that it plays out the same
+	// whichever worker it's given to
+	std::unique_ptr<Search> *searches = e.searches;
+	std::unique_ptr<MonteCarloSearch> *trees = e.trees;
+	for (int i = 0; i < 2; ++i)
+	{
+		if (trees[i])
+		{
+			trees[i]->clear();
+			trees[i]->setSeed(seed + (game * 2) + i);
+			continue;
+		}
+		e.tts[i]->clear();
+		searches[i]->clear();
+		searches[i]->setSeed(seed + (game * 2) + i);
+	}
+
+	Evaluator evaluator;
+
+	// Give up on games which go on for ever, since jumps can go back and
+	// forth indefinitely, and score them as they stand
+	for (int ply = 0; ply < 2000; ++ply)
+	{
+		piece p = b.getPlayer();
+		int side = ((p - pc_player_1) + game) & 1;
+		PackedMove m;
+		if (trees[side])
+		{
+			if (!trees[side]->findMove(b, m))
+				break;
+			t.nodes[side] += trees[side]->getNodes();
+		} else {
+			if (!searches[side]->findMove(b, m))
+				break;
+			t.nodes[side] += searches[side]->getNodes();
+		}
+		++t.moves[side];
+
+		b.makeMove(m);
+		if (samples)
+		{
+			// Searches judge positions after their own player has moved,
+			// so that's what's recorded, from the point of view of the
+			// player who's just moved.  Scores only mean anything compared
+			// with each other, so the features are how that player stands
+			// against whichever opponent has the most pieces.
+			int scores[4];
+			b.getScores(scores[0], scores[1], scores[2], scores[3]);
+			int rival = -1;
+			for (int i = 0; i < spec.players; ++i)
+			{
+				if ((i != p - pc_player_1) && ((rival == -1) || (scores[i] > scores[rival])))
+					rival = i;
+			}
+			Sample sample;
+			sample.side = side;
+			int theirs[EVAL_FEATURES];
+			evaluator.getFeatures(b, p, sample.features);
+			evaluator.getFeatures(b, (piece)(pc_player_1 + rival), theirs);
+			for (int i = 0; i < EVAL_FEATURES; ++i)
+				sample.features[i] -= theirs[i];
+			samples->push_back(sample);
+		}
+		if (!b.skipBlockedPlayers(p))
+		{
+			b.fillEmpty(p);
+			break;
+		}
+	}
+
+	int scores[4];
+	b.getScores(scores[0], scores[1], scores[2], scores[3]);
+	int best[2] = { -1, -1 };
+	for (int i = 0; i < spec.players; ++i)
+	{
+		int side = (i + game) & 1;
+		best[side] = std::max(best[side], scores[i]);
+	}
+	if (best[0] > best[1])
+		return 1;
+	else if (best[0] < best[1])
+		return -1;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	EngineSpec engines[2];
+	std::vector<BoardSpec> boards;
+	int games = 20;
+	unsigned int jobs = std::thread::hardware_concurrency();
+	unsigned int seed = std::chrono::system_clock::now().time_since_epoch().count();
+	const char *corpus_name = NULL;
+
+	engines[0].text = "time=50";
+	engines[1].text = "time=50";
+	for (int i = 1; i < argc; ++i)
+	{
+		const char *arg = argv[i];
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = (value != NULL);
+		if (ok && (strcmp(arg, "-a") == 0))
+			ok = parseEngine(value, engines[0]);
+		else if (ok && (strcmp(arg, "-b") == 0))
+			ok = parseEngine(value, engines[1]);
+		else if (ok && (strcmp(arg, "-B") == 0))
+			ok = parseBoards(value, boards);
+		else if (ok && (strcmp(arg, "-n") == 0))
+			ok = ((games = atoi(value)) > 0);
+		else if (ok && (strcmp(arg, "-j") == 0))
+		{
+			// Checked before it goes into "jobs", which is unsigned
+			const int n = atoi(value);
+			ok = (n > 0);
+			if (ok)
+				jobs = n;
+		}
+		else if (ok && (strcmp(arg, "-s") == 0))
+			seed = strtoul(value, NULL, 10);
+		else if (ok && (strcmp(arg, "-o") == 0))
+			corpus_name = value;
+		else
+			ok = false;
+		if (!ok)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+	if (boards.empty())
+		parseBoards("sq7", boards);
+	if (jobs == 0)
+		jobs = 1;
+	OpeningBook books[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		if (!engines[i].book.empty() && !books[i].open(engines[i].book.c_str()))
+		{
+			fprintf(stderr, "Couldn't open book %s\n", engines[i].book.c_str());
+			return 1;
+		}
+	}
+
+	// Training positions are written one to a line: the result of the
+	// game for the player to move (1 for a win, 0.5 for a draw, 0 for a
+	// loss), then the position's features for them less those for their
+	// main rival, under a header naming the features
+	FILE *corpus = NULL;
+	if (corpus_name)
+	{
+		corpus = fopen(corpus_name, "w");
+		if (!corpus)
+		{
+			fprintf(stderr, "Couldn't write %s\n", corpus_name);
+			return 1;
+		}
+		fprintf(corpus, "result");
+		for (int i = 0; i < EVAL_FEATURES; ++i)
+			fprintf(corpus, " %s", EvalWeights::getName(i));
+		fprintf(corpus, "\n");
+	}
+
+	printf("A: %s\nB: %s\nseed: %u\n\n", engines[0].text.c_str(),
+		engines[1].text.c_str(), seed);
+	printf("%-10s %6s %6s %6s %6s %8s %10s %10s\n", "board", "games",
+		"A won", "drawn", "B won", "games/s", "A nodes/mv", "B nodes/mv");
+
+	for (std::vector<BoardSpec>::const_iterator b = boards.begin(); b != boards.end(); ++b)
+	{
+		// Games are handed out to worker threads one at a time
+		std::atomic<int> next(0);
+		std::mutex lock;
+		Tally total;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::vector<std::thread> workers;
+		for (unsigned int j = 0; j < std::min(jobs, (unsigned int)games); ++j)
+		{
+			workers.push_back(std::thread([&]()
+			{
+				Engines e;
+				setupEngines(engines, books, e);
+				for (int game = next++; game < games; game = next++)
+				{
+					Tally t;
+					std::vector<Sample> samples;
+					int result = playGame(*b, e, game, seed, t, corpus ? &samples : NULL);
+
+					std::lock_guard<std::mutex> guard(lock);
+					for (size_t k = 0; k < samples.size(); ++k)
+					{
+						const Sample &sample = samples[k];
+						int won = (sample.side == 0) ? result : -result;
+						fprintf(corpus, "%s", (won > 0) ? "1" : ((won < 0) ? "0" : "0.5"));
+						for (int i = 0; i < EVAL_FEATURES; ++i)
+							fprintf(corpus, " %d", sample.features[i]);
+						fprintf(corpus, "\n");
+					}
+					++total.games;
+					if (result > 0)
+						++total.wins;
+					else if (result < 0)
+						++total.losses;
+					else
+						++total.draws;
+					for (int i = 0; i < 2; ++i)
+					{
+						total.nodes[i] += t.nodes[i];
+						total.moves[i] += t.moves[i];
+					}
+				}
+			}));
+		}
+		for (size_t j = 0; j < workers.size(); ++j)
+			workers[j].join();
+
+		double elapsed = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - start).count();
+		printf("%-10s %6d %6d %6d %6d %8.2f %10lu %10lu\n", b->text.c_str(),
+			total.games, total.wins, total.draws, total.losses,
+			total.games / elapsed,
+			total.moves[0] ? (total.nodes[0] / total.moves[0]) : 0,
+			total.moves[1] ? (total.nodes[1] / total.moves[1]) : 0);
+		fflush(stdout);
+	}
+	if (corpus && (fclose(corpus) != 0))
+	{
+		fprintf(stderr, "Couldn't write %s\n", corpus_name);
+		return 1;
+	}
+	return 0;
+}
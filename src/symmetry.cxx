@@ -0,0 +1,78 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "symmetry.hxx"
+
+//
+// Implementation
+//
+
+// Each player's pieces in the position's canonical orientation
+uint64_t canonicalise(const BoardState &b, Bitboard pieces[4], int &symmetry)
+{
+	const BoardGeometry &g = *b.getGeometry();
+	uint64_t hash = b.getCanonicalHash(symmetry);
+	const std::vector<uint16_t> &map = g.symmetry[symmetry];
+	for (int p = 0; p < 4; ++p)
+	{
+		Bitboard from(b.getPieces((piece)(pc_player_1 + p)));
+		pieces[p].clear();
+		for (int sq = from.pop(g.words); sq != -1; sq = from.pop(g.words))
+			pieces[p].set(map[sq]);
+	}
+	return hash;
+}
+
+// Packed move as it is after the given symmetry.  Jump directions turn with
+// the board, so jumps are unpacked into squares and packed again.
+static PackedMove transform(const BoardGeometry &g, const int symmetry, const PackedMove m)
+{
+	if (m == PackedMove::none())
+		return m;
+	const std::vector<uint16_t> &map = g.symmetry[symmetry];
+	const int dest = map[m.dest()];
+	if (m.isClone())
+		return PackedMove(dest);
+	return PackedMove(dest, g.jumpDirection(map[g.jumpSource(m.dest(), m.direction())], dest));
+}
+
+PackedMove toCanonical(const BoardGeometry &g, const int symmetry, const PackedMove m)
+{
+	return transform(g, symmetry, m);
+}
+
+PackedMove fromCanonical(const BoardGeometry &g, const int symmetry, const PackedMove m)
+{
+	return transform(g, g.inverse[symmetry], m);
+}
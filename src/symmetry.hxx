@@ -0,0 +1,57 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_SYMMETRY_HXX
+#define INFECTOR_SYMMETRY_HXX
+
+class BoardState;
+
+// Canonical forms of positions.  Reflecting or rotating a position (see
+// BoardGeometry::symmetry) doesn't change who's winning, or what the best
+// move is once it's turned the same way, so anything remembered about one
+// orientation holds for all of them.  Of all its orientations, a position's
+// canonical one is whichever has the lowest piece hash; BoardState keeps the
+// hash for every orientation up to date, so finding it is cheap.
+//
+// BoardState::getCanonicalHash gives the canonical hash along with the
+// transform which took the position there.  Moves remembered for the
+// canonical position must go through toCanonical on their way in, and
+// fromCanonical on their way back out, to be turned the right way round.
+
+// Square index "sq" as it is in the canonical orientation, for a position
+// whose canonical hash came with the given transform
+inline int toCanonical(const BoardGeometry &g, const int symmetry, const int sq)
+{
+	return g.symmetry[symmetry][sq];
+}
+
+// Square index "sq" in the canonical orientation as it is on the board
+inline int fromCanonical(const BoardGeometry &g, const int symmetry, const int sq)
+{
+	return g.symmetry[g.inverse[symmetry]][sq];
+}
+
+// The same for packed moves.  PackedMove::none() stays as it is.
+PackedMove toCanonical(const BoardGeometry &g, const int symmetry, const PackedMove m);
+PackedMove fromCanonical(const BoardGeometry &g, const int symmetry, const PackedMove m);
+
+// Set "pieces" to each player's pieces, in the position's canonical
+// orientation, and return its canonical hash and the transform which took
+// it there
+uint64_t canonicalise(const BoardState &b, Bitboard pieces[4], int &symmetry);
+
+#endif
@@ -0,0 +1,407 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+// Correctness checks for the game engine, run by "meson test": move tree
+// sizes against known counts, and checks that the fast paths agree with
+// the plain ones over positions from random games.  Prints each failure,
+// and exits with a non-zero status if there were any.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardgeometry.hxx"
+#include "boardstate.hxx"
+#include "evaluator.hxx"
+#include "perft.hxx"
+#include "playout.hxx"
+
+//
+// Types
+//
+
+// A board to test on, and the game type it was set up from
+struct Board
+{
+	const char *name;
+	GameType gt;
+	Board(const char *n, const bool square, const int size, const int players)
+		: name(n)
+	{
+		gt.square = square;
+		gt.w = size;
+		gt.h = size;
+		gt.player_1 = pt_ai;
+		gt.player_2 = pt_ai;
+		if (players == 4)
+		{
+			gt.player_3 = pt_ai;
+			gt.player_4 = pt_ai;
+		}
+	};
+};
+
+//
+// Globals
+//
+
+static int failures = 0;
+
+//
+// Implementation
+//
+
+// Count a failure, and say what it was, unless "ok"
+static void check(const bool ok, const Board &b, const char *what, const long expected,
+	const long actual)
+{
+	if (ok)
+		return;
+	printf("FAIL %s: %s: expected %ld, got %ld\n", b.name, what, expected, actual);
+	++failures;
+}
+
+// Every position from a few random games, played with a fixed seed
+static std::vector<BoardState> randomPositions(Board &board, const int games)
+{
+	std::vector<BoardState> positions;
+	std::mt19937 random(1);
+	for (int game = 0; game < games; ++game)
+	{
+		BoardState b(&board.gt);
+		std::vector<PackedMove> moves(b.getMaxMoves());
+		for (;;)
+		{
+			positions.push_back(b);
+			piece p = b.getPlayer();
+			unsigned int n = b.generateMoves(p, moves.data(), moves.size());
+			b.makeMove(moves[random() % n]);
+			if (!b.skipBlockedPlayers(p))
+				break;
+		}
+	}
+	return positions;
+}
+
+// Move tree sizes from the starting position, counting each clone into a
+// square once however many pieces could make it.  (The original generator
+// listed every source-destination pair, giving 6652 and 165656 at sq7
+// plies 3 and 4, and 17106 at hex5 ply 3.)
+static void testPerft()
+{
+	Board sq7("sq7", true, 7, 2), hex5("hex5", false, 5, 2);
+	const uint64_t sq7_counts[] = { 16, 256, 6460, 155888 };
+	const uint64_t hex5_counts[] = { 24, 570, 16824 };
+
+	Perft perft;
+	perft.setThreads(1);
+	BoardState b(&sq7.gt);
+	for (int d = 1; d <= 4; ++d)
+	{
+		uint64_t n = perft.count(b, d);
+		check(n == sq7_counts[d - 1], sq7, "perft", sq7_counts[d - 1], n);
+	}
+	BoardState h(&hex5.gt);
+	for (int d = 1; d <= 3; ++d)
+	{
+		uint64_t n = perft.count(h, d);
+		check(n == hex5_counts[d - 1], hex5, "perft", hex5_counts[d - 1], n);
+	}
+}
+
+// Making then unmaking every move leaves the board as it was
+static void testMakeUnmake(Board &board)
+{
+	std::vector<BoardState> positions(randomPositions(board, 4));
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		BoardState &b = positions[i];
+		const int words = b.getGeometry()->words;
+		const uint64_t hash = b.getHash();
+		const piece player = b.getPlayer();
+		int scores[4];
+		b.getScores(scores[0], scores[1], scores[2], scores[3]);
+		Bitboard pieces[4];
+		for (int p = 0; p < 4; ++p)
+			pieces[p] = b.getPieces((piece)(pc_player_1 + p));
+
+		std::vector<PackedMove> moves(b.getMaxMoves());
+		unsigned int n = b.generateMoves(player, moves.data(), moves.size());
+		for (unsigned int m = 0; m < n; ++m)
+		{
+			MoveUndo u = b.makeMove(moves[m]);
+			b.unmakeMove(u);
+			check(b.getHash() == hash, board, "hash after unmakeMove", hash, b.getHash());
+			check(b.getPlayer() == player, board, "player after unmakeMove", player,
+				b.getPlayer());
+			int after[4];
+			b.getScores(after[0], after[1], after[2], after[3]);
+			for (int p = 0; p < 4; ++p)
+			{
+				check(after[p] == scores[p], board, "score after unmakeMove", scores[p],
+					after[p]);
+				for (int w = 0; w < words; ++w)
+				{
+					const uint64_t was = pieces[p].words[w];
+					const uint64_t is = b.getPieces((piece)(pc_player_1 + p)).words[w];
+					check(is == was, board, "pieces after unmakeMove", was, is);
+				}
+			}
+		}
+	}
+}
+
+// Taking a snapshot of a board and setting a board up from it gives the
+// same board back, hash included, which checks the hash kept up to date
+// move by move against one worked out from scratch
+static void testPosition(Board &board)
+{
+	std::vector<BoardState> positions(randomPositions(board, 4));
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		const BoardState &b = positions[i];
+		Position p;
+		b.getPosition(p);
+		BoardState copy(p);
+		check(copy.getHash() == b.getHash(), board, "hash from Position", b.getHash(),
+			copy.getHash());
+		check(copy.getPlayer() == b.getPlayer(), board, "player from Position",
+			b.getPlayer(), copy.getPlayer());
+		int scores[4], after[4];
+		b.getScores(scores[0], scores[1], scores[2], scores[3]);
+		copy.getScores(after[0], after[1], after[2], after[3]);
+		for (int j = 0; j < 4; ++j)
+			check(after[j] == scores[j], board, "score from Position", scores[j], after[j]);
+
+		// Everything else is compared through the snapshot, byte by byte
+		Position q;
+		copy.getPosition(q);
+		check(memcmp(&p, &q, sizeof(p)) == 0, board, "Position round trip", 0, 1);
+	}
+}
+
+// Number of squares in a ring around "sq" (see BoardGeometry) in "set"
+static int ringCount(const BoardGeometry &g, const Bitboard &set, const int sq,
+	const unsigned int distance)
+{
+	int n = 0;
+	const uint16_t *end = g.endRing(sq, distance);
+	for (const uint16_t *i = g.beginRing(sq, distance); i != end; ++i)
+		n += set.test(*i);
+	return n;
+}
+
+// Count the evaluation features square by square, the way the evaluator
+// did before it worked on whole bitboards
+static void scalarFeatures(const BoardState &b, const piece me, int features[EVAL_FEATURES])
+{
+	const BoardGeometry &g = *b.getGeometry();
+	const Bitboard &mine = b.getPieces(me);
+	Bitboard empty, enemy;
+	b.getEmpty(empty);
+	for (int w = 0; w < g.words; ++w)
+		enemy.words[w] = g.valid.words[w] & ~(empty.words[w] | mine.words[w]);
+	for (int i = 0; i < EVAL_FEATURES; ++i)
+		features[i] = 0;
+
+	Bitboard squares(g.valid);
+	for (int sq = squares.pop(g.words); sq != -1; sq = squares.pop(g.words))
+	{
+		// On hexagonal boards, two of the eight squares surrounding this
+		// one are actually at jump distance
+		int corner_mine = 0, corner_enemy = 0;
+		for (int c = 0; c < g.cornersize; ++c)
+		{
+			const int n = sq + g.corner[c];
+			if ((n < 0) || (n >= g.bits) || !g.valid.test(n))
+				continue;
+			corner_mine += mine.test(n);
+			corner_enemy += enemy.test(n);
+		}
+
+		if (mine.test(sq))
+		{
+			++features[ef_material];
+			features[ef_defended] += ringCount(g, mine, sq, 1);
+			continue;
+		}
+		if (enemy.test(sq))
+		{
+			features[ef_attacking] += (corner_mine > 0);
+			continue;
+		}
+
+		const int near_mine = ringCount(g, mine, sq, 1);
+		if ((near_mine > 0) || (ringCount(g, mine, sq, 2) > 0))
+			++features[ef_mobility];
+		if ((near_mine == 0) || ((ringCount(g, enemy, sq, 1) == 0) && (corner_enemy == 0)))
+			continue;
+
+		// Threatened: an enemy moving here would capture our pieces next
+		// to it, taking away their moves, and block our others' jumps here
+		features[ef_threatened] += near_mine;
+		int lost = ringCount(g, mine, sq, 2);
+		const uint16_t *end = g.endRing(sq, 1);
+		for (const uint16_t *i = g.beginRing(sq, 1); i != end; ++i)
+		{
+			if (mine.test(*i))
+				lost += ringCount(g, empty, *i, 1) + ringCount(g, empty, *i, 2);
+		}
+		features[ef_exposure] += lost / 10;
+	}
+}
+
+// The evaluator's features agree with counting them square by square, and
+// its scores with weighting them, both for the board as it is and (every
+// few positions, as there are a lot of them) for the boards after each move
+static void testEvaluator(Board &board)
+{
+	Evaluator eval;
+	const EvalWeights &weights = eval.getWeights();
+	std::vector<BoardState> positions(randomPositions(board, 2));
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		const BoardState &b = positions[i];
+		std::vector<PackedMove> moves(b.getMaxMoves());
+		std::vector<int> scores(b.getMaxMoves());
+		unsigned int n = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+		for (int p = pc_player_1; p <= pc_player_4; ++p)
+		{
+			const piece me = (piece)p;
+			if (b.getPieces(me).count(b.getGeometry()->words) == 0)
+				continue;
+			int expected[EVAL_FEATURES], actual[EVAL_FEATURES];
+			scalarFeatures(b, me, expected);
+			eval.getFeatures(b, me, actual);
+			int score = 0;
+			for (int f = 0; f < EVAL_FEATURES; ++f)
+			{
+				check(actual[f] == expected[f], board, EvalWeights::getName(f), expected[f],
+					actual[f]);
+				score += expected[f] * weights.weights[f];
+			}
+			score /= EVAL_SCALE;
+			check(eval.evaluate(b, me) == score, board, "evaluate", score,
+				eval.evaluate(b, me));
+
+			if (i % 8 != 0)
+				continue;
+			eval.evaluateMoves(b, me, moves.data(), n, scores.data());
+			for (unsigned int m = 0; m < n; ++m)
+			{
+				BoardState after(b);
+				after.makeMove(moves[m]);
+				check(scores[m] == eval.evaluate(after, me), board, "evaluateMoves",
+					eval.evaluate(after, me), scores[m]);
+			}
+		}
+	}
+}
+
+// A playout stopped after one move leaves the scores one of the legal
+// moves would have, and one played to the end fills the board.  Every
+// few positions are enough.
+static void testPlayout(Board &board)
+{
+	std::mt19937 random(1);
+	std::vector<BoardState> positions(randomPositions(board, 2));
+	for (size_t i = 0; i < positions.size(); i += 3)
+	{
+		const BoardState &b = positions[i];
+		const int squares = b.getGeometry()->squares;
+		std::vector<PackedMove> moves(b.getMaxMoves());
+		unsigned int n = b.generateMoves(b.getPlayer(), moves.data(), moves.size());
+		std::vector<std::vector<int> > outcomes;
+		for (unsigned int m = 0; m < n; ++m)
+		{
+			BoardState after(b);
+			piece p = after.getPlayer();
+			after.makeMove(moves[m]);
+			if (!after.skipBlockedPlayers(p))
+				after.fillEmpty(p);
+			std::vector<int> scores(4);
+			after.getScores(scores[0], scores[1], scores[2], scores[3]);
+			outcomes.push_back(scores);
+		}
+
+		const playoutpolicy policies[2] = { pp_uniform, pp_captures };
+		for (int k = 0; k < 2; ++k)
+		{
+			bool finished;
+			std::vector<int> scores(4);
+			int made = playout(b, random, policies[k], 1, scores.data(), finished);
+			check(made == 1, board, "moves in a playout limited to 1", 1, made);
+			bool legal = false;
+			for (size_t j = 0; j < outcomes.size(); ++j)
+				legal |= (outcomes[j] == scores);
+			check(legal, board, "playout move is legal", 1, 0);
+
+			made = playout(b, random, policies[k], 0, scores.data(), finished);
+			check(finished, board, "playout finished", 1, 0);
+			int total = 0;
+			for (int p = 0; p < 4; ++p)
+				total += (scores[p] > 0) ? scores[p] : 0;
+			check(total == squares, board, "squares filled by playout", squares, total);
+		}
+	}
+}
+
+int main()
+{
+	Board boards[] = {
+		Board("sq7", true, 7, 2),
+		Board("hex5", false, 5, 2),
+		Board("sq8/4", true, 8, 4),
+		Board("sq20", true, 20, 2),
+		Board("hex9", false, 9, 2)
+	};
+	const size_t count = sizeof(boards) / sizeof(boards[0]);
+
+	testPerft();
+	for (size_t i = 0; i < count; ++i)
+		testMakeUnmake(boards[i]);
+	for (size_t i = 0; i < count; ++i)
+		testPosition(boards[i]);
+	for (size_t i = 0; i < count; ++i)
+		testEvaluator(boards[i]);
+	for (size_t i = 0; i < count; ++i)
+		testPlayout(boards[i]);
+
+	if (failures)
+		printf("%d failures\n", failures);
+	else
+		printf("All tests passed\n");
+	return failures ? 1 : 0;
+}
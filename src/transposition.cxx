@@ -0,0 +1,101 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "boardstate.hxx"
+#include "transposition.hxx"
+
+//
+// Implementation
+//
+
+TranspositionTable::TranspositionTable(const size_t mb)
+	: m_Mask(0)
+{
+	resize(mb);
+}
+
+void TranspositionTable::resize(const size_t mb)
+{
+	// Largest power of two number of slots which fits, and at least one
+	size_t slots = 1;
+	while ((slots * 2 * 2 * sizeof(uint64_t)) <= (mb << 20))
+		slots *= 2;
+	m_pSlots.reset(new std::atomic<uint64_t>[slots * 2]);
+	m_Mask = slots - 1;
+	clear();
+}
+
+void TranspositionTable::clear()
+{
+	for (size_t i = 0; i <= m_Mask; ++i)
+	{
+		m_pSlots[i * 2].store(0, std::memory_order_relaxed);
+		m_pSlots[(i * 2) + 1].store(0, std::memory_order_relaxed);
+	}
+}
+
+bool TranspositionTable::probe(const uint64_t key, TTEntry &e) const
+{
+	size_t i = (key & m_Mask) * 2;
+	uint64_t check = m_pSlots[i].load(std::memory_order_relaxed);
+	uint64_t data = m_pSlots[i + 1].load(std::memory_order_relaxed);
+	if (((check ^ data) != key) || ((data & 3) == tb_none))
+		return false;
+
+	e.score = (int32_t)(uint32_t)(data >> 32);
+	e.best.bits = (data >> 10) & 0xffff;
+	e.depth = (data >> 2) & 0xff;
+	e.bound = (ttbound)(data & 3);
+	return true;
+}
+
+void TranspositionTable::store(const uint64_t key, const int score, const int depth,
+	const ttbound bound, const PackedMove best)
+{
+	size_t i = (key & m_Mask) * 2;
+
+	// Keep deeper results for the same position
+	uint64_t check = m_pSlots[i].load(std::memory_order_relaxed);
+	uint64_t old = m_pSlots[i + 1].load(std::memory_order_relaxed);
+	if (((check ^ old) == key) && (((old >> 2) & 0xff) > (uint64_t)depth))
+		return;
+
+	uint64_t data = ((uint64_t)(uint32_t)score << 32)
+		| ((uint64_t)best.bits << 10)
+		| ((uint64_t)(depth & 0xff) << 2)
+		| (uint64_t)bound;
+	m_pSlots[i].store(key ^ data, std::memory_order_relaxed);
+	m_pSlots[i + 1].store(data, std::memory_order_relaxed);
+}
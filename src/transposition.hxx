@@ -0,0 +1,79 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_TRANSPOSITION_HXX
+#define INFECTOR_TRANSPOSITION_HXX
+
+// Kinds of score stored in the transposition table: the exact value of a
+// position, or a bound on it from a search which was cut short
+enum ttbound
+{
+	tb_none,
+	tb_upper,
+	tb_lower,
+	tb_exact
+};
+
+// What the transposition table knows about a position.  A position with no
+// best move has PackedMove::none().
+struct TTEntry
+{
+	int score;
+	int depth;
+	ttbound bound;
+	PackedMove best;
+};
+
+// Fixed-size hash table of search results, indexed by Zobrist hash.  Any
+// number of threads may probe and store at once without locking: each slot
+// is a pair of 64-bit words, the data and the data XORed with the full key,
+// so a slot torn by two simultaneous writers just fails to match on the next
+// probe.  Newer results always replace older ones for different positions,
+// and replace shallower ones for the same position.
+class TranspositionTable
+{
+	public:
+		// Create a table using at most "mb" megabytes
+		TranspositionTable(const size_t mb);
+
+		// Throw away the contents and change the size
+		void resize(const size_t mb);
+
+		// Forget everything
+		void clear();
+
+		// Look up a position, returning false if it isn't in the table
+		bool probe(const uint64_t key, TTEntry &e) const;
+
+		// Record the result of searching a position
+		void store(const uint64_t key, const int score, const int depth,
+			const ttbound bound, const PackedMove best);
+
+		// Number of positions the table can hold
+		size_t getSize() const
+		{
+			return m_Mask + 1;
+		};
+
+	private:
+		// Two words per slot: key ^ data, then data.  Data is packed as
+		// score (32 bits), best move (16), depth (8), bound (2).
+		std::unique_ptr<std::atomic<uint64_t>[]> m_pSlots;
+		size_t m_Mask;
+};
+
+#endif
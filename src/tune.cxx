@@ -0,0 +1,325 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+// Evaluation tuner: fit the evaluation weights to the results of self-play
+// games (see infector-selfplay's -o option), so that scores predict who
+// will win as well as possible.
+//
+// This is "Texel" tuning: each position's score is turned into an expected
+// result by a logistic curve, and the weights are adjusted by gradient
+// descent to minimise the mean squared difference between the expected and
+// actual results.  The steepness of the curve is fitted first, to the
+// weights we start from, so that it matches the scale of the scores.
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+// System headers
+#ifndef MINGW
+#include <unistd.h>
+#endif
+
+// Project headers
+#include "gametype.hxx"
+#include "bitboard.hxx"
+#include "evaluator.hxx"
+
+//
+// Types
+//
+
+// Every position in the corpus: the features of each, one after another,
+// and the result of its game for the player to move
+struct Corpus
+{
+	std::vector<float> features;
+	std::vector<float> results;
+};
+
+//
+// Implementation
+//
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"Usage: %s [options] CORPUS...\n"
+		"  -w FILE    weights to start from (default: the built-in ones)\n"
+		"  -o FILE    write the tuned weights to FILE\n"
+		"  -i N       gradient descent steps (default 1000)\n"
+		"  -r RATE    learning rate (default 1)\n"
+		"  -j JOBS    threads to work out gradients with (default: one\n"
+		"             per CPU)\n"
+		"CORPUS files are written by infector-selfplay's -o option.\n",
+		argv0);
+}
+
+// Add the positions in the given file to the corpus
+static bool load(const char *filename, Corpus &c)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f)
+		return false;
+
+	// The header names the features, which must be the ones we know
+	std::string expected("result");
+	for (int i = 0; i < EVAL_FEATURES; ++i)
+		expected += std::string(" ") + EvalWeights::getName(i);
+	char line[1024];
+	bool ok = (fgets(line, sizeof(line), f) != NULL);
+	if (ok)
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+		ok = (expected == line);
+	}
+
+	while (ok && fgets(line, sizeof(line), f))
+	{
+		char *p = line;
+		char *end;
+		float result = strtof(p, &end);
+		ok = (end != p);
+		for (int i = 0; ok && (i < EVAL_FEATURES); ++i)
+		{
+			p = end;
+			c.features.push_back(strtol(p, &end, 10));
+			ok = (end != p);
+		}
+		c.results.push_back(result);
+	}
+	fclose(f);
+	if (c.features.size() != c.results.size() * EVAL_FEATURES)
+		ok = false;
+	return ok;
+}
+
+// Mean squared error of the expected results for the given weights, and
+// (if "gradient" isn't NULL) its gradient with respect to each weight.
+// Positions are shared out between the given number of threads.
+static double meanError(const Corpus &c, const double weights[EVAL_FEATURES], const double k,
+	const unsigned int jobs, double *gradient)
+{
+	const size_t n = c.results.size();
+	std::vector<double> errors(jobs, 0);
+	std::vector<double> gradients(jobs * EVAL_FEATURES, 0);
+	std::vector<std::thread> workers;
+	for (unsigned int j = 0; j < jobs; ++j)
+	{
+		workers.push_back(std::thread([&, j]()
+		{
+			double e = 0;
+			double *g = &gradients[j * EVAL_FEATURES];
+			for (size_t i = (n * j) / jobs; i < (n * (j + 1)) / jobs; ++i)
+			{
+				const float *f = &c.features[i * EVAL_FEATURES];
+				double score = 0;
+				for (int w = 0; w < EVAL_FEATURES; ++w)
+					score += weights[w] * f[w];
+				double expected = 1 / (1 + exp(-k * score / EVAL_SCALE));
+				double diff = expected - c.results[i];
+				e += diff * diff;
+				if (gradient)
+				{
+					double slope = 2 * diff * expected * (1 - expected) * k / EVAL_SCALE;
+					for (int w = 0; w < EVAL_FEATURES; ++w)
+						g[w] += slope * f[w];
+				}
+			}
+			errors[j] = e;
+		}));
+	}
+	for (unsigned int j = 0; j < jobs; ++j)
+		workers[j].join();
+
+	double total = 0;
+	for (unsigned int j = 0; j < jobs; ++j)
+		total += errors[j];
+	if (gradient)
+	{
+		for (int w = 0; w < EVAL_FEATURES; ++w)
+		{
+			gradient[w] = 0;
+			for (unsigned int j = 0; j < jobs; ++j)
+				gradient[w] += gradients[(j * EVAL_FEATURES) + w];
+			gradient[w] /= n;
+		}
+	}
+	return total / n;
+}
+
+int main(int argc, char *argv[])
+{
+	EvalWeights start;
+	const char *output = NULL;
+	int iterations = 1000;
+	double rate = 1;
+	unsigned int jobs = std::thread::hardware_concurrency();
+
+	int i = 1;
+	for (; (i < argc) && (argv[i][0] == '-'); ++i)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		bool ok = (value != NULL);
+		if (ok && (strcmp(argv[i], "-w") == 0))
+			ok = start.load(value);
+		else if (ok && (strcmp(argv[i], "-o") == 0))
+			output = value;
+		else if (ok && (strcmp(argv[i], "-i") == 0))
+			ok = ((iterations = atoi(value)) >= 0);
+		else if (ok && (strcmp(argv[i], "-r") == 0))
+			ok = ((rate = atof(value)) > 0);
+		else if (ok && (strcmp(argv[i], "-j") == 0))
+		{
+			// Checked before it goes into "jobs", which is unsigned
+			const int n = atoi(value);
+			ok = (n > 0);
+			if (ok)
+				jobs = n;
+		}
+		else
+			ok = false;
+		if (!ok)
+		{
+			usage(argv[0]);
+			return 1;
+		}
+		++i;
+	}
+	if (i == argc)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+	if (jobs == 0)
+		jobs = 1;
+
+	Corpus corpus;
+	for (; i < argc; ++i)
+	{
+		if (!load(argv[i], corpus))
+		{
+			fprintf(stderr, "Couldn't read corpus %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (corpus.results.empty())
+	{
+		fprintf(stderr, "No positions to tune with\n");
+		return 1;
+	}
+	printf("%lu positions\n", (unsigned long)corpus.results.size());
+
+	double weights[EVAL_FEATURES];
+	for (int w = 0; w < EVAL_FEATURES; ++w)
+		weights[w] = start.weights[w];
+
+	// Fit the curve's steepness, by golden section search on its logarithm
+	const double phi = (sqrt(5.0) - 1) / 2;
+	double lo = -6, hi = 2;
+	double a = hi - (phi * (hi - lo)), b = lo + (phi * (hi - lo));
+	double ea = meanError(corpus, weights, exp(a), jobs, NULL);
+	double eb = meanError(corpus, weights, exp(b), jobs, NULL);
+	while (hi - lo > 0.001)
+	{
+		if (ea < eb)
+		{
+			hi = b;
+			b = a;
+			eb = ea;
+			a = hi - (phi * (hi - lo));
+			ea = meanError(corpus, weights, exp(a), jobs, NULL);
+		} else {
+			lo = a;
+			a = b;
+			ea = eb;
+			b = lo + (phi * (hi - lo));
+			eb = meanError(corpus, weights, exp(b), jobs, NULL);
+		}
+	}
+	const double k = exp((lo + hi) / 2);
+	printf("scale %g, error %.6f\n", k, meanError(corpus, weights, k, jobs, NULL));
+
+	// Progress is redrawn on one line on a terminal, but given a line of
+	// its own when going to a file or pipe
+#ifndef MINGW
+	const bool terminal = isatty(fileno(stdout));
+#else
+	const bool terminal = false;
+#endif
+
+	// Adam: gradient descent with a step size of its own for each weight,
+	// since features are counted on very different scales
+	double m[EVAL_FEATURES] = { 0 }, v[EVAL_FEATURES] = { 0 };
+	double gradient[EVAL_FEATURES];
+	const double beta1 = 0.9, beta2 = 0.999;
+	for (int step = 1; step <= iterations; ++step)
+	{
+		double e = meanError(corpus, weights, k, jobs, gradient);
+		for (int w = 0; w < EVAL_FEATURES; ++w)
+		{
+			m[w] = (beta1 * m[w]) + ((1 - beta1) * gradient[w]);
+			v[w] = (beta2 * v[w]) + ((1 - beta2) * gradient[w] * gradient[w]);
+			double mhat = m[w] / (1 - pow(beta1, step));
+			double vhat = v[w] / (1 - pow(beta2, step));
+			weights[w] -= rate * mhat / (sqrt(vhat) + 1e-12);
+		}
+		if ((step % 100 == 0) || (step == iterations))
+		{
+			if (terminal)
+				printf("\rstep %d, error %.6f", step, e);
+			else
+				printf("step %d, error %.6f\n", step, e);
+			fflush(stdout);
+		}
+	}
+	if (terminal)
+		printf("\r");
+	printf("error %.6f%s\n", meanError(corpus, weights, k, jobs, NULL),
+		terminal ? "                    " : "");
+
+	// The corpus holds features relative to the main rival, so the weights
+	// are only good for scoring that way
+	EvalWeights tuned;
+	tuned.rival = true;
+	for (int w = 0; w < EVAL_FEATURES; ++w)
+	{
+		tuned.weights[w] = (int)lround(weights[w]);
+		printf("%-12s %6d -> %6d\n", EvalWeights::getName(w), start.weights[w],
+			tuned.weights[w]);
+	}
+	if (output && !tuned.save(output))
+	{
+		fprintf(stderr, "Couldn't write %s\n", output);
+		return 1;
+	}
+	return 0;
+}
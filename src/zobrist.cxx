@@ -0,0 +1,73 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+
+//
+// Includes
+//
+
+// Standard
+#include <config.h>
+
+// Language headers
+#include <cstdint>
+
+// Project headers
+#include "bitboard.hxx"
+#include "zobrist.hxx"
+
+//
+// Globals
+//
+
+uint64_t zobrist_pieces[4][BITBOARD_BITS];
+uint64_t zobrist_turn[4];
+uint64_t zobrist_searcher[4];
+
+//
+// Implementation
+//
+
+// Fill in the keys before main() runs, using SplitMix64: it's tiny, and
+// unlike the standard library's generators its output is pinned down here
+// rather than by the implementation
+static struct ZobristInit
+{
+	uint64_t state;
+
+	uint64_t next()
+	{
+		uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	};
+
+	ZobristInit()
+		: state(0x496e666563746f72ULL)
+	{
+		for (int p = 0; p < 4; ++p)
+		{
+			for (int sq = 0; sq < BITBOARD_BITS; ++sq)
+				zobrist_pieces[p][sq] = next();
+		}
+		for (int p = 0; p < 4; ++p)
+			zobrist_turn[p] = next();
+		for (int p = 0; p < 4; ++p)
+			zobrist_searcher[p] = next();
+	};
+} zobrist_init;
@@ -0,0 +1,33 @@
+// Copyright 2008-2009, 2012, 2018 Philip Allison <mangobrain@googlemail.com>
+
+//    This file is part of Infector.
+//
+//    Infector is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    Infector is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Infector.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INFECTOR_ZOBRIST_HXX
+#define INFECTOR_ZOBRIST_HXX
+
+// Random keys for Zobrist hashing of board positions.  A position's hash is
+// the XOR of the key for each piece on the board (indexed from player 1, then
+// by square) and the key for the player whose turn it is, so it can be kept
+// up to date as pieces come and go.  The keys are generated from a fixed
+// seed, so a given position always hashes to the same value.
+extern uint64_t zobrist_pieces[4][BITBOARD_BITS];
+extern uint64_t zobrist_turn[4];
+
+// Extra keys for searches which score positions differently depending on
+// which player they're being searched for
+extern uint64_t zobrist_searcher[4];
+
+#endif